@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+#ifndef TUIO_PROPERTIES_H
+#define TUIO_PROPERTIES_H
+
+/* Receive and commit counters of a core device.
+ * 32 bit, TUIO_STAT_COUNT values, read-only.  Values wrap around. */
+#define TUIO_PROP_STATISTICS "Tuio Statistics"
+
+#define TUIO_STAT_PACKETS       0 /* datagrams read from the socket */
+#define TUIO_STAT_FRAMES        1 /* frames committed */
+#define TUIO_STAT_STALE_FRAMES  2 /* frames dropped by the fseq check */
+#define TUIO_STAT_FSEQ_GAPS     3 /* fseq numbers never seen */
+#define TUIO_STAT_PARSE_US      4 /* time spent decoding packets */
+#define TUIO_STAT_COMMIT_US     5 /* time spent committing frames */
+#define TUIO_STAT_OBJECTS       6 /* live objects after the last commit */
+#define TUIO_STAT_ALLOCS        7 /* objects allocated */
+#define TUIO_STAT_EVENTS        8 /* events posted */
+#define TUIO_STAT_OUTPUT_FRAMES 9 /* frames that posted events */
+#define TUIO_STAT_AGED_FRAMES   10 /* frames older than MaxFrameAge */
+#define TUIO_STAT_FRAME_AGE_US  11 /* age of the last frame at commit */
+#define TUIO_STAT_CLOCK_OFFSET_MS 12 /* tracker clock offset, signed */
+#define TUIO_STAT_CLOCK_DRIFT_PPM 13 /* tracker clock drift, signed */
+#define TUIO_STAT_KERNEL_DROPS  14 /* packets dropped by a full socket/ring */
+#define TUIO_STAT_RCVBUF        15 /* socket receive buffer size in bytes */
+#define TUIO_STAT_REJECTED      16 /* sessions rejected by the region filter */
+#define TUIO_STAT_BUDGET_HITS   17 /* reads that stopped at the read budget */
+#define TUIO_STAT_BACKLOG_DROPS 18 /* packets discarded by BacklogPolicy */
+#define TUIO_STAT_TIMEOUTS      19 /* sources and sessions timed out */
+#define TUIO_STAT_EVICTIONS     20 /* sessions evicted by MaxSessions */
+#define TUIO_STAT_COUNT         21
+
+/* Histogram of the time between reading the first packet of a frame and
+ * posting its last event.  32 bit, TUIO_LATENCY_BUCKETS values, read-only.
+ * Buckets are log-linear in microseconds with four buckets per power of
+ * two; see TUIO_LATENCY_BUCKET_US() for the lower bound of a bucket.  The
+ * last bucket also counts everything above it. */
+#define TUIO_PROP_LATENCY "Tuio Latency"
+
+#define TUIO_LATENCY_BUCKETS    64
+#define TUIO_LATENCY_BUCKET_US(b) \
+    ((b) < 4 ? (b) : (4 + ((b) & 3)) << (((b) >> 2) - 1))
+
+/* Per endpoint receive counters of a core device with Option "Listen".
+ * 32 bit, TUIO_LISTEN_STAT_COUNT values per endpoint, in the order the
+ * endpoints were given, read-only.  Values wrap around. */
+#define TUIO_PROP_LISTEN_STATISTICS "Tuio Listen Statistics"
+
+#define TUIO_LISTEN_PACKETS     0 /* packets received on the endpoint */
+#define TUIO_LISTEN_DROPS       1 /* datagrams dropped by its full socket */
+#define TUIO_LISTEN_STAT_COUNT  2
+
+/* Calibration matrix of a core device, applied to (x, y, 1) in TUIO
+ * coordinates, giving 0 to 1 over the output range.  Float, 9 values,
+ * row-major. */
+#define TUIO_PROP_CALIBRATION "Tuio Calibration"
+
+/* Valuator range the calibrated 0 to 1 is mapped to: x min, x max, y min,
+ * y max.  32 bit, 4 values, within 0 to 0x7FFFFFFF. */
+#define TUIO_PROP_OUTPUT_RANGE "Tuio Output Range"
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+#ifndef TUIO_RING_H
+#define TUIO_RING_H
+
+#include <stdint.h>
+
+/* Shared memory ring a tracker on the same host writes OSC packets into,
+ * with Option "Transport" "shm:path".
+ *
+ * The producer connects to the unix stream socket at path and receives,
+ * as SCM_RIGHTS ancillary data of a one byte message, two file
+ * descriptors: the shared memory holding a TuioRingHeader followed by
+ * size bytes of data, and an eventfd.  The connection is closed by the
+ * driver after that.  There is one ring per device, so only one producer
+ * may write to it at a time.
+ *
+ * head and tail count bytes and wrap around at 2^32; size is a power of
+ * two and offsets into data are taken modulo size.  Each record is a
+ * uint32_t packet length followed by the OSC packet, padded to a multiple
+ * of four bytes.  Records don't wrap: if a record doesn't fit before the
+ * end of data, the producer writes TUIO_RING_WRAP as the length (if there
+ * are at least four bytes left) and starts the record at offset 0.
+ *
+ * To write a packet the producer:
+ *
+ *   1. checks there are enough free bytes, size - (head - tail), for the
+ *      record and any skipped bytes at the end of data; if not, it
+ *      increments dropped and discards the packet
+ *   2. writes the record at head, then a write barrier
+ *   3. advances head past the record
+ *   4. writes 1 to the eventfd to wake the driver
+ *
+ * The driver reads records up to head and advances tail past them.  All
+ * values are in the byte order of the host. */
+
+#define TUIO_RING_MAGIC 0x54524e47 /* "TRNG" */
+#define TUIO_RING_VERSION 1
+#define TUIO_RING_SIZE (1 << 20) /* Bytes of data */
+#define TUIO_RING_WRAP 0xffffffff /* Length of the record skipping the end */
+
+/* Size of a record holding a packet of len bytes */
+#define TUIO_RING_RECORD(len) (4 + (((len) + 3) & ~3))
+
+typedef struct _TuioRingHeader {
+    uint32_t magic; /* TUIO_RING_MAGIC */
+    uint32_t version; /* TUIO_RING_VERSION */
+    uint32_t size; /* Bytes of data after the header */
+    uint32_t dropped; /* Packets the producer discarded, ring was full */
+
+    /* Written by the producer and the driver; on separate cache lines */
+    uint32_t head;
+    char pad0[60];
+    uint32_t tail;
+    char pad1[60];
+} TuioRingHeader;
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+#ifndef TUIO_SHM_H
+#define TUIO_SHM_H
+
+#include <stdint.h>
+
+/* Committed frames of a core device with Option "SharedMemory" set are
+ * published in a POSIX shared memory object named "/tuio-<name>", see
+ * shm_open(3).  The object holds a TuioShmHeader followed by a ring of
+ * TUIO_SHM_SLOTS frames, and is only written by the driver.
+ *
+ * To read the latest frame:
+ *
+ *   1. h = head; if h is 0, nothing has been published yet
+ *   2. frame = &frames[(h - 1) % TUIO_SHM_SLOTS]
+ *   3. s = frame->seq; if s is odd, the frame is being written, retry
+ *   4. copy the frame, then read frame->seq again (with a read barrier
+ *      between the copy and both reads of seq)
+ *   5. if seq changed, the copy is torn, retry from 1
+ *
+ * Readers never block the driver and need no locks.  A reader that
+ * falls more than TUIO_SHM_SLOTS frames behind only sees the latest ones.
+ * All values are in the byte order of the host. */
+
+#define TUIO_SHM_PREFIX "/tuio-"
+#define TUIO_SHM_MAGIC 0x5455494f /* "TUIO" */
+#define TUIO_SHM_VERSION 1
+#define TUIO_SHM_SLOTS 8
+#define TUIO_SHM_MAX_OBJECTS 64 /* Objects beyond this are left out */
+
+typedef struct _TuioShmObject {
+    int32_t id; /* TUIO session id */
+    float x, y; /* Normalised position, 0 to 1 */
+    float xvel, yvel;
+} TuioShmObject;
+
+typedef struct _TuioShmFrame {
+    uint32_t seq; /* Seqlock, odd while the frame is written */
+    int32_t fseq; /* TUIO frame sequence number */
+    uint32_t frame; /* Number of the frame, counting from 1 */
+    uint32_t num_objects;
+    int64_t time_us; /* CLOCK_MONOTONIC time the frame was committed */
+    TuioShmObject objects[TUIO_SHM_MAX_OBJECTS];
+} TuioShmFrame;
+
+typedef struct _TuioShmHeader {
+    uint32_t magic; /* TUIO_SHM_MAGIC */
+    uint32_t version; /* TUIO_SHM_VERSION */
+    uint32_t slots; /* TUIO_SHM_SLOTS */
+    uint32_t max_objects; /* TUIO_SHM_MAX_OBJECTS */
+    uint32_t head; /* Frames published so far */
+    uint32_t pad;
+    TuioShmFrame frames[TUIO_SHM_SLOTS];
+} TuioShmHeader;
+
+#endif
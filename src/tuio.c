@@ -28,6 +28,24 @@
 #endif
 
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <net/if.h>
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
 
 #include <xf86Xinput.h>
 #include <xf86_OSlib.h>
@@ -35,10 +53,6 @@
 
 #include "tuio.h"
 
-/* InputInfoPtr for main tuio device */
-static InputInfoPtr g_pInfo;
-static int pipefd[2] = {-1, -1};
-
 /* Module Functions */
 static pointer
 TuioPlug(pointer, pointer, int *, int *);
@@ -62,6 +76,12 @@ TuioReadInput(InputInfoPtr);
 static int
 TuioControl(DeviceIntPtr, int);
 
+/* Core devices read from the TUIO socket, subdevices only route events */
+#define IS_CORE_DEVICE(pInfo) ((pInfo)->read_input == TuioReadInput)
+
+static void
+TuioPropertyInit(DeviceIntPtr device);
+
 /* Internal Functions */
 static int
 _hal_create_devices(InputInfoPtr pInfo, int num);
@@ -88,6 +108,149 @@ _lo_error(int num,
          const char *msg,
          const char *path);
 
+static CARD32
+_time_us(void);
+
+static int
+_tuio_recv(InputInfoPtr pInfo, SourcePtr src);
+
+static void
+_tuio_packet(InputInfoPtr pInfo, char *data, int len, int64_t rx,
+             int64_t wall);
+
+static Bool
+_fseq_stale(TuioDevicePtr pTuio, int fseq);
+
+static Bool
+_bundle_stale(TuioDevicePtr pTuio, const char *data, int len,
+              uint64_t timetag);
+
+/* Sockets packets are read from */
+static Bool
+_read_budget_done(TuioDevicePtr pTuio);
+
+static SourcePtr
+_source_add(InputInfoPtr pInfo, int type, int fd);
+
+static void
+_source_remove(InputInfoPtr pInfo, SourcePtr src);
+
+static void
+_source_unref(TuioDevicePtr pTuio, SourcePtr src);
+
+static SourcePtr
+_sender_get(InputInfoPtr pInfo, SourcePtr src,
+            struct sockaddr_storage *addr, socklen_t addrlen);
+
+static void
+_source_read(InputInfoPtr pInfo, SourcePtr src);
+
+static int
+_stream_listen(InputInfoPtr pInfo);
+
+static void
+_stream_accept(InputInfoPtr pInfo, SourcePtr src);
+
+static void
+_stream_read(InputInfoPtr pInfo, SourcePtr src);
+
+static lo_server
+_server_new(InputInfoPtr pInfo);
+
+static int
+_ring_open(InputInfoPtr pInfo);
+
+static void
+_ring_handshake(InputInfoPtr pInfo, int fd);
+
+static void
+_ring_read(InputInfoPtr pInfo, SourcePtr src);
+
+static void
+_ring_close(TuioDevicePtr pTuio);
+
+static int
+_transport_open(InputInfoPtr pInfo);
+
+static void
+_transport_close(InputInfoPtr pInfo);
+
+static void
+_suspend(InputInfoPtr pInfo);
+
+static CARD32
+_drain_timer(OsTimerPtr timer, CARD32 now, pointer arg);
+
+static void
+_drain(InputInfoPtr pInfo);
+
+static void
+_frame_commit(InputInfoPtr pInfo);
+
+static void
+_backlog(InputInfoPtr pInfo, SourcePtr src);
+
+static Bool
+_backlog_newest(InputInfoPtr pInfo, SourcePtr src);
+
+static CARD32
+_resume_timer(OsTimerPtr timer, CARD32 now, pointer arg);
+
+static CARD32
+_clock_update(TuioDevicePtr pTuio, SourcePtr src, int64_t rx,
+              int64_t timetag);
+
+static void
+_socket_setup(InputInfoPtr pInfo, int fd);
+
+static void
+_socket_filter(InputInfoPtr pInfo, int fd);
+
+static void
+_parse_sources(InputInfoPtr pInfo, const char *name, char *sources);
+
+static void
+_parse_endpoints(InputInfoPtr pInfo, const char *name, char *endpoints);
+
+static int
+_endpoints_open(InputInfoPtr pInfo);
+
+static void
+_multicast_iface(InputInfoPtr pInfo, int fd);
+
+static void
+_latency_add(TuioDevicePtr pTuio, CARD32 us);
+
+/* Calibration */
+static Bool
+_transform_check(const float *matrix, const int *range);
+
+static Bool
+_transform_update(TuioDevicePtr pTuio, const float *matrix, const int *range);
+
+static void
+_transform_apply(TuioDevicePtr pTuio, ObjectPtr obj);
+
+/* Shared memory frame export */
+static void
+_shm_open(InputInfoPtr pInfo);
+
+static void
+_shm_publish(TuioDevicePtr pTuio);
+
+static void
+_shm_close(TuioDevicePtr pTuio);
+
+/* Region filter */
+static void
+_grid_init(InputInfoPtr pInfo, const char *name, char *zones, float border);
+
+static void
+_grid_move(TuioDevicePtr pTuio, ObjectPtr obj, float x, float y);
+
+static Bool
+_grid_reject(TuioDevicePtr pTuio, ObjectPtr obj);
+
 /* Object and Subdev list manipulation functions */
 static ObjectPtr
 _object_get(ObjectPtr head, int id);
@@ -101,6 +264,55 @@ _object_add(ObjectPtr *obj_list, ObjectPtr obj);
 static ObjectPtr
 _object_remove(ObjectPtr *obj_list, int id);
 
+static void
+_object_alive(InputInfoPtr pInfo, lo_arg **argv, int argc);
+
+static void
+_object_evict(InputInfoPtr pInfo);
+
+/* Watchdog */
+static void
+_watchdog_arm(InputInfoPtr pInfo);
+
+static void
+_watchdog_add(InputInfoPtr pInfo, ObjectPtr obj);
+
+static void
+_watchdog_remove(ObjectPtr obj);
+
+static CARD32
+_watchdog_timer(OsTimerPtr timer, CARD32 now, pointer arg);
+
+static int
+_source_release(InputInfoPtr pInfo, SourcePtr src);
+
+static void
+_source_timeout(InputInfoPtr pInfo, SourcePtr src, CARD32 now);
+
+static void
+_object_motion(TuioDevicePtr pTuio, ObjectPtr obj);
+
+static Bool
+_object_postable(ObjectPtr obj);
+
+static void
+_object_post(TuioDevicePtr pTuio, ObjectPtr obj);
+
+static CARD32
+_flush_timer(OsTimerPtr timer, CARD32 now, pointer arg);
+
+static void
+_flush_schedule(InputInfoPtr pInfo);
+
+static void
+_flush(InputInfoPtr pInfo);
+
+static void
+_object_release(InputInfoPtr pInfo, ObjectPtr obj);
+
+static void
+_gesture_update(InputInfoPtr pInfo);
+
 static void
 _subdev_add(InputInfoPtr pInfo, SubDevicePtr subdev);
 
@@ -110,6 +322,21 @@ _subdev_remove(InputInfoPtr pInfo, InputInfoPtr sub_pInfo);
 static SubDevicePtr
 _subdev_get(InputInfoPtr pInfo, SubDevicePtr *subdev_list);
 
+static InputInfoPtr
+_core_find(const char *name);
+
+static void
+_subdev_queue_parking(InputInfoPtr pInfo);
+
+static void
+_subdev_cancel_parking(InputInfoPtr pInfo);
+
+static Bool
+_subdev_update_parking(ClientPtr client, pointer closure);
+
+static CARD32
+_park_timer(OsTimerPtr timer, CARD32 now, pointer arg);
+
 static int
 _hal_remove_device(InputInfoPtr pInfo);
 
@@ -177,9 +404,13 @@ TuioPreInit(InputDriverPtr drv,
 {
     InputInfoPtr  pInfo;
     TuioDevicePtr pTuio = NULL;
-    ObjectPtr obj;
-    char *type;
-    int num_subdev, tuio_port;
+    SubDevicePtr subdev;
+    char *type, *core_name, *sources, *zones, *policy, *str;
+    static const float identity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+    float matrix[9];
+    int range[4];
+    double border;
+    int num_subdev, tuio_port, tick;
 
     if (!(pInfo = xf86AllocateInput(drv, 0)))
         return NULL;
@@ -190,13 +421,42 @@ TuioPreInit(InputDriverPtr drv,
     if (type != NULL && strcmp(type, "Object") == 0) {
         xf86Msg(X_INFO, "%s: TUIO subdevice found\n", dev->identifier);
 
+        /* Bind the subdevice to the core device that created it */
+        core_name = xf86CheckStrOption(dev->commonOptions, "Core", NULL);
+        if (!(subdev = xcalloc(1, sizeof(SubDeviceRec)))) {
+            xf86DeleteInput(pInfo, 0);
+            return NULL;
+        }
+        subdev->pInfo = pInfo;
+        subdev->core = _core_find(core_name);
+        if (subdev->core == NULL) {
+            xf86Msg(X_ERROR, "%s: No TUIO core device '%s' found\n",
+                    dev->identifier, core_name ? core_name : "");
+            xfree(subdev);
+            xf86DeleteInput(pInfo, 0);
+            return NULL;
+        }
+        pInfo->private = subdev;
+
     } else {
 
         if (!(pTuio = xcalloc(1, sizeof(TuioDeviceRec)))) {
             xf86DeleteInput(pInfo, 0);
             return NULL;
         }
-        g_pInfo = pInfo;
+
+        if (!(pTuio->core_subdev = xcalloc(1, sizeof(SubDeviceRec)))) {
+            xfree(pTuio);
+            xf86DeleteInput(pInfo, 0);
+            return NULL;
+        }
+        pTuio->core_subdev->pInfo = pInfo;
+        pTuio->core_subdev->core = pInfo;
+        pTuio->subdev_pipe[0] = -1;
+        pTuio->subdev_pipe[1] = -1;
+        pTuio->epoll_fd = -1;
+        pTuio->ring_fd = -1;
+        pTuio->ring_event = -1;
 
         pInfo->private = pTuio;
 
@@ -219,10 +479,50 @@ TuioPreInit(InputDriverPtr drv,
                     dev->identifier, tuio_port, DEFAULT_PORT);
             tuio_port = DEFAULT_PORT;
         }
-        xf86Msg(X_INFO, "%s: TUIO UDP Port set to %i\n",
-                dev->identifier, tuio_port);
         pTuio->tuio_port = tuio_port;
 
+        /* Get the transport: "udp", "tcp", "unix:path", "unix-stream:path"
+         * or "shm:path" */
+        str = xf86SetStrOption(dev->commonOptions, "Transport", "udp");
+        if (xf86NameCmp(str, "tcp") == 0) {
+            pTuio->transport = TRANSPORT_TCP;
+        } else if (strncmp(str, "unix:", 5) == 0 && str[5] != '\0') {
+            pTuio->transport = TRANSPORT_UNIX;
+            pTuio->transport_path = xstrdup(str + 5);
+        } else if (strncmp(str, "unix-stream:", 12) == 0 && str[12] != '\0') {
+            pTuio->transport = TRANSPORT_UNIX_STREAM;
+            pTuio->transport_path = xstrdup(str + 12);
+        } else if (strncmp(str, "shm:", 4) == 0 && str[4] != '\0') {
+            pTuio->transport = TRANSPORT_SHM;
+            pTuio->transport_path = xstrdup(str + 4);
+        } else {
+            if (xf86NameCmp(str, "udp") != 0)
+                xf86Msg(X_WARNING, "%s: Unknown Transport %s, using udp\n",
+                        dev->identifier, str);
+            pTuio->transport = TRANSPORT_UDP;
+        }
+        xfree(str);
+
+        /* Get the addresses to listen on instead of Port */
+        str = xf86CheckStrOption(dev->commonOptions, "Listen", NULL);
+        if (str != NULL) {
+            if (pTuio->transport == TRANSPORT_UDP ||
+                pTuio->transport == TRANSPORT_TCP)
+                _parse_endpoints(pInfo, dev->identifier, str);
+            else
+                xf86Msg(X_WARNING, "%s: Listen needs the udp or tcp "
+                        "Transport, ignored\n", dev->identifier);
+            xfree(str);
+        }
+
+        if (pTuio->transport_path)
+            xf86Msg(X_INFO, "%s: TUIO socket set to %s\n",
+                    dev->identifier, pTuio->transport_path);
+        else if (pTuio->num_endpoints == 0)
+            xf86Msg(X_INFO, "%s: TUIO %s Port set to %i\n", dev->identifier,
+                    pTuio->transport == TRANSPORT_TCP ? "TCP" : "UDP",
+                    tuio_port);
+
         /* Get setting for checking fseq numbers in TUIO packets */
         pTuio->fseq_threshold= xf86CheckIntOption(dev->commonOptions,
                 "FseqThreshold", DEFAULT_FSEQ_THRESHOLD);
@@ -240,6 +540,175 @@ TuioPreInit(InputDriverPtr drv,
         /* Get setting for whether to hide devices when idle */
         pTuio->hide_devices = xf86CheckBoolOption(dev->commonOptions,
                 "PseudoHide", True);
+
+        /* Get settings for posting two finger scroll and zoom gestures */
+        pTuio->gestures = xf86CheckBoolOption(dev->commonOptions,
+                "Gestures", False);
+        pTuio->scroll_distance = xf86SetRealOption(dev->commonOptions,
+                "ScrollDistance", DEFAULT_SCROLL_DISTANCE);
+        if (pTuio->scroll_distance <= 0)
+            pTuio->scroll_distance = DEFAULT_SCROLL_DISTANCE;
+        pTuio->gesture.zoom = 1.0;
+
+        /* Get the maximum number of frames per second to post */
+        pTuio->max_frame_rate = xf86SetIntOption(dev->commonOptions,
+                "MaxFrameRate", 0);
+        if (pTuio->max_frame_rate < 0) {
+            xf86Msg(X_WARNING, "%s: Invalid MaxFrameRate %i, not using it\n",
+                    dev->identifier, pTuio->max_frame_rate);
+            pTuio->max_frame_rate = 0;
+        } else if (pTuio->max_frame_rate > 1000) {
+            xf86Msg(X_WARNING, "%s: MaxFrameRate %i is too high, using "
+                    "1000\n", dev->identifier, pTuio->max_frame_rate);
+            pTuio->max_frame_rate = 1000;
+        }
+
+        /* Get the age in ms after which frames are too old to post */
+        pTuio->max_frame_age = xf86SetIntOption(dev->commonOptions,
+                "MaxFrameAge", 0);
+        if (pTuio->max_frame_age < 0)
+            pTuio->max_frame_age = 0;
+
+        /* Get the times in ms after which the touches of a silent tracker
+         * or a session that is no longer updated are released */
+        pTuio->session_timeout = xf86SetIntOption(dev->commonOptions,
+                "SessionTimeout", 0);
+        if (pTuio->session_timeout < 0)
+            pTuio->session_timeout = 0;
+        pTuio->source_timeout = xf86SetIntOption(dev->commonOptions,
+                "SourceTimeout", 0);
+        if (pTuio->source_timeout < 0)
+            pTuio->source_timeout = 0;
+        tick = pTuio->session_timeout;
+        if (tick == 0 ||
+            (pTuio->source_timeout > 0 && pTuio->source_timeout < tick))
+            tick = pTuio->source_timeout;
+        pTuio->watchdog_tick = max(tick / 8, MIN_WATCHDOG_TICK);
+
+        pTuio->recv_buf = xalloc(TUIO_MAX_PACKET);
+
+        /* Get the limits of a single read, and what to do beyond them */
+        pTuio->read_budget = xf86SetIntOption(dev->commonOptions,
+                "ReadBudget", 0);
+        if (pTuio->read_budget < 0)
+            pTuio->read_budget = 0;
+        pTuio->read_time = xf86SetIntOption(dev->commonOptions,
+                "ReadTime", 0);
+        if (pTuio->read_time < 0)
+            pTuio->read_time = 0;
+        policy = xf86SetStrOption(dev->commonOptions, "BacklogPolicy",
+                "yield");
+        if (xf86NameCmp(policy, "newest") == 0) {
+            pTuio->backlog_policy = BACKLOG_NEWEST;
+            pTuio->backlog_stash = xalloc(BACKLOG_STASH);
+        }
+        else if (xf86NameCmp(policy, "oldest") == 0)
+            pTuio->backlog_policy = BACKLOG_OLDEST;
+        else if (xf86NameCmp(policy, "yield") == 0)
+            pTuio->backlog_policy = BACKLOG_YIELD;
+        else
+            xf86Msg(X_WARNING, "%s: Unknown BacklogPolicy %s\n",
+                    dev->identifier, policy);
+        xfree(policy);
+
+        /* Get the number of sessions tracked at once, and which one makes
+         * room for a new session beyond that */
+        pTuio->max_sessions = xf86SetIntOption(dev->commonOptions,
+                "MaxSessions", DEFAULT_MAX_SESSIONS);
+        if (pTuio->max_sessions < 1 || pTuio->max_sessions > MAX_SESSIONS) {
+            xf86Msg(X_WARNING, "%s: MaxSessions must be 1 to %i\n",
+                    dev->identifier, MAX_SESSIONS);
+            pTuio->max_sessions = DEFAULT_MAX_SESSIONS;
+        }
+        policy = xf86SetStrOption(dev->commonOptions, "EvictionPolicy",
+                "lru");
+        if (xf86NameCmp(policy, "oldest") == 0)
+            pTuio->eviction_policy = EVICT_OLDEST;
+        else if (xf86NameCmp(policy, "lru") == 0)
+            pTuio->eviction_policy = EVICT_LRU;
+        else
+            xf86Msg(X_WARNING, "%s: Unknown EvictionPolicy %s\n",
+                    dev->identifier, policy);
+        xfree(policy);
+
+        /* Get the size of the socket receive buffer */
+        pTuio->rcvbuf = xf86SetIntOption(dev->commonOptions,
+                "ReceiveBuffer", DEFAULT_RCVBUF);
+        if (pTuio->rcvbuf < 0)
+            pTuio->rcvbuf = DEFAULT_RCVBUF;
+
+        /* Get settings for dropping non-TUIO traffic in the kernel */
+        pTuio->socket_filter = xf86CheckBoolOption(dev->commonOptions,
+                "SocketFilter", False);
+        sources = xf86CheckStrOption(dev->commonOptions,
+                "AllowedSources", NULL);
+        if (sources != NULL) {
+            _parse_sources(pInfo, dev->identifier, sources);
+            xfree(sources);
+        }
+
+        /* Get the regions of the surface where touches are ignored */
+        zones = xf86CheckStrOption(dev->commonOptions, "DeadZones", NULL);
+        border = xf86SetRealOption(dev->commonOptions, "DeadBorder", 0.0);
+        pTuio->palm_contacts = xf86SetIntOption(dev->commonOptions,
+                "PalmContacts", 0);
+        if (pTuio->palm_contacts < 0)
+            pTuio->palm_contacts = 0;
+        pTuio->grid_size = xf86SetIntOption(dev->commonOptions,
+                "GridSize", DEFAULT_GRID_SIZE);
+        if (pTuio->grid_size < 1 || pTuio->grid_size > MAX_GRID_SIZE)
+            pTuio->grid_size = DEFAULT_GRID_SIZE;
+        _grid_init(pInfo, dev->identifier, zones, border);
+        xfree(zones);
+
+        /* Get the calibration matrix and the valuator range it maps to */
+        memcpy(matrix, identity, sizeof(matrix));
+        str = xf86CheckStrOption(dev->commonOptions, "Calibration", NULL);
+        if (str != NULL &&
+            sscanf(str, "%f %f %f %f %f %f %f %f %f",
+                   &matrix[0], &matrix[1], &matrix[2], &matrix[3],
+                   &matrix[4], &matrix[5], &matrix[6], &matrix[7],
+                   &matrix[8]) != 9) {
+            xf86Msg(X_WARNING, "%s: Calibration needs 9 values\n",
+                    dev->identifier);
+            memcpy(matrix, identity, sizeof(matrix));
+        }
+        xfree(str);
+        range[0] = range[2] = 0;
+        range[1] = range[3] = 0x7FFFFFFF;
+        str = xf86CheckStrOption(dev->commonOptions, "OutputRange", NULL);
+        if (str != NULL &&
+            sscanf(str, "%i %i %i %i",
+                   &range[0], &range[1], &range[2], &range[3]) != 4) {
+            xf86Msg(X_WARNING, "%s: OutputRange needs 4 values\n",
+                    dev->identifier);
+            range[0] = range[2] = 0;
+            range[1] = range[3] = 0x7FFFFFFF;
+        }
+        xfree(str);
+        if (!_transform_update(pTuio, matrix, range)) {
+            xf86Msg(X_WARNING, "%s: Invalid calibration, not using it\n",
+                    dev->identifier);
+            range[0] = range[2] = 0;
+            range[1] = range[3] = 0x7FFFFFFF;
+            _transform_update(pTuio, identity, range);
+        }
+
+        /* Get the name of the shared memory frames are published in */
+        pTuio->shm_name = xf86CheckStrOption(dev->commonOptions,
+                "SharedMemory", NULL);
+
+        /* Get the multicast group to join, if any */
+        pTuio->mcast_group = xf86CheckStrOption(dev->commonOptions,
+                "MulticastGroup", NULL);
+        pTuio->mcast_iface = xf86CheckStrOption(dev->commonOptions,
+                "MulticastInterface", NULL);
+        if (pTuio->mcast_group && pTuio->num_endpoints > 0) {
+            xf86Msg(X_WARNING, "%s: MulticastGroup only applies to Port, "
+                    "ignored with Listen\n", dev->identifier);
+            xfree(pTuio->mcast_group);
+            pTuio->mcast_group = NULL;
+        }
     }
 
     /* Set up InputInfoPtr */
@@ -269,6 +738,28 @@ TuioUnInit(InputDriverPtr drv,
            InputInfoPtr pInfo,
            int flags)
 {
+    SubDevicePtr subdev;
+    InputInfoPtr other;
+
+    if (IS_CORE_DEVICE(pInfo)) {
+        /* Detach any subdevices that outlive their core device */
+        for (other = xf86InputDevs; other != NULL; other = other->next) {
+            if (other->read_input == TuioObjReadInput && other->private) {
+                subdev = other->private;
+                if (subdev->core == pInfo)
+                    subdev->core = NULL;
+            }
+        }
+        _subdev_cancel_parking(pInfo);
+        _free_tuiodev(pInfo->private);
+    } else if (pInfo->private) {
+        subdev = pInfo->private;
+        if (subdev->core)
+            _subdev_remove(subdev->core, pInfo);
+        xfree(subdev);
+    }
+
+    pInfo->private = NULL;
     xf86DeleteInput(pInfo, 0);
 }
 
@@ -287,390 +778,3027 @@ static void
 TuioReadInput(InputInfoPtr pInfo)
 {
     TuioDevicePtr pTuio = pInfo->private;
-    ObjectPtr *obj_list = &pTuio->obj_list;
-    ObjectPtr obj = pTuio->obj_list;
-    SubDevicePtr *subdev_list = &pTuio->subdev_list;
-    ObjectPtr objtmp;
-    int valuators[NUM_VALUATORS];
+    struct epoll_event events[MAX_READ_EVENTS];
+    SourcePtr src, next;
+    int i, n;
 
-    while (xf86WaitForInput(pInfo->fd, 0) > 0)
-    {
-        /* The liblo handler will set this flag if anything was processed */
-        pTuio->processed = 0;
-
-        /* liblo will receive a message and call the appropriate
-         * handlers (i.e. _tuio_lo_cur2d_hande()) */
-        lo_server_recv_noblock(pTuio->server, 0);
-
-        /* During the processing of the previous message/bundle,
-         * any "active" messages will be handled by flagging
-         * the listed object ids.  Now that processing is done,
-         * remove any dead object ids and set any pending changes.
-         * Also check to make sure the processed data was newer than
-         * the last processed data */
-        if (pTuio->processed &&
-            (pTuio->fseq_new > pTuio->fseq_old ||
-             pTuio->fseq_old - pTuio->fseq_new > pTuio->fseq_threshold)) {
-
-            while (obj != NULL) {
-                if (!obj->alive) {
-                    if (obj->subdev && pTuio->post_button_events) {
-                        /* Post button "up" event */
-                        xf86PostButtonEvent(obj->subdev->pInfo->dev, TRUE, 1, FALSE, 0, 0);
-                    }
-                    valuators[0] = 0x7FFFFFFF;
-                    valuators[1] = 0x7FFFFFFF;
-                    valuators[2] = 0;
-                    valuators[3] = 0;
-
-                    xf86PostMotionEventP(obj->subdev->pInfo->dev,
-                            TRUE, /* is_absolute */
-                            0, /* first_valuator */
-                            NUM_VALUATORS, /* num_valuators */
-                            valuators);
-
-                    objtmp = obj->next;
-                    obj = _object_remove(obj_list, obj->id);
-                    _subdev_add(pInfo, obj->subdev);
-                    xfree(obj);
-                    obj = objtmp;
-
-
-                } else {
-                    /* Object is alive.  Check to see if an update has been set.
-                     * If it has been updated and it has a subdevice to send
-                     * events on, send the event) */
-                    if (obj->pending.set && obj->subdev) {
-                        obj->xpos = obj->pending.xpos;
-                        obj->ypos = obj->pending.ypos;
-                        obj->xvel = obj->pending.xvel;
-                        obj->yvel = obj->pending.yvel;
-                        obj->pending.set = False;
-
-                        /* OKAY FOR NOW, maybe update with a better range? */
-                        /* TODO: Add more valuators with additional information */
-                        valuators[0] = obj->xpos * 0x7FFFFFFF;
-                        valuators[1] = obj->ypos * 0x7FFFFFFF;
-                        valuators[2] = obj->xvel * 0x7FFFFFFF;
-                        valuators[3] = obj->yvel * 0x7FFFFFFF;
-
-                        xf86PostMotionEventP(obj->subdev->pInfo->dev,
-                                TRUE, /* is_absolute */
-                                0, /* first_valuator */
-                                NUM_VALUATORS, /* num_valuators */
-                                valuators);
-                        
-                        if (obj->pending.button) {
-                            xf86PostButtonEvent(obj->subdev->pInfo->dev, TRUE, 1, TRUE, 0, 0);
-                            obj->pending.button = False;
-                        }
-                    }
-                    obj->alive = 0; /* Reset for next message */
-                    obj = obj->next;
-                }
-            }
-            pTuio->fseq_old = pTuio->fseq_new;
-        }
+    pTuio->read_start = _time_us();
+    pTuio->read_packets = 0;
+    pTuio->budget_hit = False;
+
+    if (pTuio->epoll_fd == -1) {
+        _source_read(pInfo, pTuio->sources);
+        return;
+    }
+
+    /* All sockets that are ready are read in one go */
+    SYSCALL(n = epoll_wait(pTuio->epoll_fd, events, MAX_READ_EVENTS, 0));
+    for (i = 0; i < n; i++)
+        _source_read(pInfo, events[i].data.ptr);
+
+    /* Packets left in stream buffers by the read budget don't make
+     * their socket ready again.  Once the budget is used up again, the
+     * resume timer reads the rest. */
+    for (src = pTuio->sources; src != NULL && !pTuio->budget_hit;
+         src = next) {
+        next = src->next;
+        if (src->backlog)
+            _source_read(pInfo, src);
     }
 }
 
 /**
- * Handle device state changes
+ * Checks whether the current TuioReadInput() call has used up its budget
  */
-static int
-TuioControl(DeviceIntPtr device,
-            int what)
+static Bool
+_read_budget_done(TuioDevicePtr pTuio)
+{
+    return (pTuio->read_budget > 0 &&
+            pTuio->read_packets >= pTuio->read_budget) ||
+           (pTuio->read_time > 0 &&
+            _time_us() - pTuio->read_start >= pTuio->read_time);
+}
+
+/**
+ * Reads what is available from a source
+ */
+static void
+_source_read(InputInfoPtr pInfo, SourcePtr src)
 {
-    InputInfoPtr pInfo = device->public.devicePrivate;
     TuioDevicePtr pTuio = pInfo->private;
-    SubDevicePtr subdev;
-    char *tuio_port;
-    int res;
 
-    switch (what)
-    {
-        case DEVICE_INIT:
-            xf86Msg(X_INFO, "%s: Init\n", pInfo->name);
-            _init_buttons(device);
-            _init_axes(device);
+    pTuio->source = src;
 
-            /* If this is a "core" device, create object devices */
-            if (pTuio) {
-                _hal_create_devices(pInfo, pTuio->init_num_subdev);
+    switch (src->type) {
+        case SOURCE_DGRAM:
+            while (xf86WaitForInput(src->fd, 0) > 0)
+            {
+                /* Don't let a flood of packets keep the server from
+                 * other input */
+                if (_read_budget_done(pTuio)) {
+                    _backlog(pInfo, src);
+                    break;
+                }
+                pTuio->read_packets++;
+
+                if (_tuio_recv(pInfo, src) <= 0)
+                    break;
             }
             break;
 
-        case DEVICE_ON: /* Open socket and start listening! */
-            xf86Msg(X_INFO, "%s: On.\n", pInfo->name);
-            if (device->public.on)
-                break;
-
-            /* If this is an object device, use a dummy pipe,
-             * and add device to subdev list */
-            if (!pTuio) {
-                if (pipefd[0] == -1) {
-                    SYSCALL(res = pipe(pipefd));
-                    if (res == -1) {
-                        xf86Msg(X_ERROR, "%s: failed to open pipe\n",
-                                pInfo->name);
-                        return BadAlloc;
-                    }
-                }
-
-                pInfo->fd = pipefd[0];
+        case SOURCE_LISTEN:
+            _stream_accept(pInfo, src);
+            break;
 
-                goto finish;
-            }
+        case SOURCE_STREAM:
+            _stream_read(pInfo, src);
+            break;
 
-            /* Setup server */
-            asprintf(&tuio_port, "%i", pTuio->tuio_port);
-            pTuio->server = lo_server_new_with_proto(tuio_port, LO_UDP, _lo_error);
-            if (pTuio->server == NULL) {
-                xf86Msg(X_ERROR, "%s: Error allocating new lo_server\n", 
-                        pInfo->name);
-                return BadAlloc;
-            }
+        case SOURCE_RING:
+            _ring_read(pInfo, src);
+            break;
+    }
+}
 
-            /* Register to receive all /tuio/2Dcur messages */
-            lo_server_add_method(pTuio->server, "/tuio/2Dcur", NULL, 
-                                 _tuio_lo_2dcur_handle, pInfo);
+/**
+ * Handles a packet read from any source.  rx is the wall clock time it
+ * arrived, in microseconds, and wall the wall clock time now.
+ */
+static void
+_tuio_packet(InputInfoPtr pInfo, char *data, int len, int64_t rx,
+             int64_t wall)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    uint32_t sec, frac;
+    uint64_t timetag = 0;
+    CARD32 start;
 
-            pInfo->fd = lo_server_get_socket_fd(pTuio->server);
+    if (pTuio->suspended)
+        return;
 
-            xf86FlushInput(pInfo->fd);
+    start = _time_us();
+
+    /* Staleness is judged against the last frame of the source, so
+     * trackers sharing the device don't make each other's frames stale.
+     * Packets without an fseq message don't commit. */
+    if (pTuio->source)
+        pTuio->fseq_old = pTuio->source->fseq;
+    pTuio->fseq_new = pTuio->fseq_old;
+
+    /* Arrival time on the monotonic clock used for everything else */
+    pTuio->packet_rx = start - (CARD32)(wall - rx);
+
+    pTuio->packet_net_age = 0;
+    if (len >= 16 && memcmp(data, "#bundle", 8) == 0) {
+        memcpy(&sec, data + 8, 4);
+        memcpy(&frac, data + 12, 4);
+        sec = ntohl(sec);
+        frac = ntohl(frac);
+
+        /* (0, 1) means "immediately", the tracker didn't set a time */
+        if (sec != 0 || frac != 1)
+            timetag = (uint64_t)sec << 32 | frac;
+        if (pTuio->source && timetag)
+            pTuio->packet_net_age = _clock_update(pTuio, pTuio->source, rx,
+                    ((int64_t)sec - NTP_EPOCH_OFFSET) * 1000000 +
+                    (int64_t)(((uint64_t)frac * 1000000) >> 32));
+    }
 
-finish:     xf86AddEnabledDevice(pInfo);
-            device->public.on = TRUE;
+    /* The liblo handler will set this flag if anything was processed */
+    pTuio->processed = 0;
+
+    /* The packet is handed to liblo, which will call the appropriate
+     * handlers (i.e. _tuio_lo_cur2d_hande()).  A late bundle of a frame
+     * that is older than the last one committed isn't: its alive message
+     * would release touches that are still down. */
+    if (_bundle_stale(pTuio, data, len, timetag))
+        pTuio->stats[TUIO_STAT_STALE_FRAMES]++;
+    else
+        lo_server_dispatch_data(pTuio->server, data, len);
+    pTuio->stats[TUIO_STAT_PACKETS]++;
+    if (pTuio->source) {
+        pTuio->source->seen = GetTimeInMillis();
+        pTuio->source->timed_out = False;
+        if (pTuio->source->endpoint >= 0)
+            pTuio->endpoint_stats[pTuio->source->endpoint *
+                                  TUIO_LISTEN_STAT_COUNT +
+                                  TUIO_LISTEN_PACKETS]++;
+    }
+    pTuio->stats[TUIO_STAT_PARSE_US] += _time_us() - start;
+
+    /* During the processing of the previous message/bundle,
+     * any "alive" messages already released the dead object ids.
+     * Now that processing is done, set any pending changes once
+     * the frame is complete.  Also check to make sure the processed
+     * data was newer than the last processed data */
+    if (!pTuio->processed)
+        return;
 
-            /* Allocate device storage and add to device list */
-            subdev = xcalloc(1, sizeof(SubDeviceRec));
-            subdev->pInfo = pInfo;
-            _subdev_add(g_pInfo, subdev);
-            break;
+    if (!pTuio->frame_started) {
+        pTuio->frame_start = pTuio->packet_rx;
+        pTuio->frame_net_age = pTuio->packet_net_age;
+        pTuio->frame_started = True;
+    }
 
-        case DEVICE_OFF:
-            xf86Msg(X_INFO, "%s: Off\n", pInfo->name);
-            if (!device->public.on)
-                break;
+    if (pTuio->fseq_new == pTuio->fseq_old)
+        return;
 
-            xf86RemoveEnabledDevice(pInfo);
+    if (!_fseq_stale(pTuio, pTuio->fseq_new)) {
 
-            if (pTuio) {
-                lo_server_free(pTuio->server);
-                pInfo->fd = -1;
-            }
-            /* Remove subdev from list - This applies for both subdevices
-             * and the "core" device */
-            _subdev_remove(g_pInfo, pInfo);
+        /* Frames never seen are only counted once the first frame
+         * of the source has set a reference fseq */
+        if (pTuio->source && pTuio->source->committed &&
+            pTuio->fseq_new > pTuio->fseq_old + 1)
+            pTuio->stats[TUIO_STAT_FSEQ_GAPS] +=
+                pTuio->fseq_new - pTuio->fseq_old - 1;
 
-            device->public.on = FALSE;
-            break;
+        _frame_commit(pInfo);
+        if (pTuio->source) {
+            pTuio->source->committed = True;
+            pTuio->source->fseq = pTuio->fseq_new;
+            pTuio->source->frame_timetag = timetag;
+        }
+    } else {
+        pTuio->stats[TUIO_STAT_STALE_FRAMES]++;
+    }
+    pTuio->frame_started = False;
+}
 
-        case DEVICE_CLOSE:
-            xf86Msg(X_INFO, "%s: Close\n", pInfo->name);
-            _hal_remove_device(pInfo);
-            break;
+/**
+ * Checks whether a frame is older than the last one committed from the
+ * same source.  fseq values that went back by more than FseqThreshold
+ * mean the tracker restarted.
+ */
+static Bool
+_fseq_stale(TuioDevicePtr pTuio, int fseq)
+{
+    return fseq < pTuio->fseq_old &&
+           pTuio->fseq_old - fseq <= pTuio->fseq_threshold;
+}
 
+/**
+ * Checks, before it is parsed, whether a bundle belongs to a frame older
+ * than the last one committed: by the fseq message it carries, or if it
+ * has none (the first bundles of a split frame), by its timetag compared
+ * to that of the last frame committed from its source.  Bundles with
+ * neither can't be told apart and are taken as current.
+ */
+static Bool
+_bundle_stale(TuioDevicePtr pTuio, const char *data, int len,
+              uint64_t timetag)
+{
+    static const char fseq_msg[] = "/tuio/2Dcur\0,si\0fseq\0\0\0";
+    const char *p;
+    uint32_t fseq;
+
+    p = memmem(data, len, fseq_msg, sizeof(fseq_msg));
+    if (p != NULL && p + sizeof(fseq_msg) + 4 <= data + len) {
+        memcpy(&fseq, p + sizeof(fseq_msg), 4);
+        return _fseq_stale(pTuio, (int)ntohl(fseq));
     }
-    return Success;
+
+    return timetag && pTuio->source && pTuio->source->frame_timetag &&
+           timetag < pTuio->source->frame_timetag;
 }
 
 /**
- * Initialize the device properties
- * TODO
+ * Called when TuioReadInput() used up its budget with packets of src
+ * still queued.  Depending on BacklogPolicy, queued datagrams are
+ * discarded without being parsed, then the rest is read from a timer once
+ * the server has handled other input.  Streams and the ingest ring always
+ * keep their packets.
  */
-TuioPropertyInit() {
+static void
+_backlog(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    int drop = 0, len, n;
+
+    /* Counted once per TuioReadInput() call, however many sources are
+     * left with a backlog */
+    if (!pTuio->budget_hit) {
+        pTuio->budget_hit = True;
+        pTuio->stats[TUIO_STAT_BUDGET_HITS]++;
+    }
+
+    if (src->type == SOURCE_STREAM || src->type == SOURCE_RING)
+        src->backlog = True;
+    else if (pTuio->backlog_policy == BACKLOG_NEWEST && pTuio->backlog_stash) {
+        if (_backlog_newest(pInfo, src))
+            return; /* Nothing left */
+    } else if (pTuio->backlog_policy == BACKLOG_NEWEST)
+        drop = MAX_BACKLOG_DROP;
+    else if (pTuio->backlog_policy == BACKLOG_OLDEST)
+        drop = pTuio->read_budget > 0 ? pTuio->read_budget :
+                                        MAX_BACKLOG_DROP / 16;
+
+    for (n = 0; n < drop; n++) {
+        SYSCALL(len = recv(src->fd, NULL, 0, MSG_DONTWAIT));
+        if (len < 0)
+            break;
+    }
+
+    if (n > 0) {
+        /* The rest of a partly read frame is gone */
+        pTuio->stats[TUIO_STAT_BACKLOG_DROPS] += n;
+        pTuio->frame_started = False;
+    }
+
+    if (n < drop)
+        return; /* Nothing left */
+
+    pTuio->resume_timer = TimerSet(pTuio->resume_timer, 0, 1,
+                                   _resume_timer, pInfo);
+}
+
+/**
+ * Discards the queued datagrams of src, except those of the newest frame.
+ * They are read without being parsed; a frame starts with the packet
+ * carrying its alive message, or with a packet from another tracker than
+ * the one before.  The packets of the newest frame are kept in the
+ * backlog stash and handled once the queue is empty.  If the frame
+ * doesn't fit, its oldest packets are discarded too.
+ *
+ * @return True if the queue is empty
+ */
+static Bool
+_backlog_newest(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    char *stash = pTuio->backlog_stash;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    SourcePtr sender, stash_sender = NULL;
+    struct timespec now;
+    int64_t wall;
+    int used = 0, kept = 0, len, n, off;
+
+    for (n = 0; n < MAX_BACKLOG_DROP; n++) {
+        addrlen = sizeof(addr);
+        SYSCALL(len = recvfrom(src->fd, pTuio->recv_buf, TUIO_MAX_PACKET,
+                               MSG_DONTWAIT, (struct sockaddr *)&addr,
+                               &addrlen));
+        if (len < 0)
+            break;
+        sender = _sender_get(pInfo, src, &addr, addrlen);
+
+        if (sender != stash_sender ||
+            memmem(pTuio->recv_buf, len, "alive\0\0\0", 8) != NULL ||
+            used + 4 + len > BACKLOG_STASH) {
+            used = 0;
+            kept = 0;
+            stash_sender = sender;
+        }
+        memcpy(stash + used, &len, 4);
+        memcpy(stash + used + 4, pTuio->recv_buf, len);
+        used += 4 + ((len + 3) & ~3);
+        kept++;
+    }
+
+    if (n == 0)
+        return True;
+
+    /* The rest of a partly read frame is gone */
+    pTuio->stats[TUIO_STAT_BACKLOG_DROPS] += n - kept;
+    pTuio->frame_started = False;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    wall = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    pTuio->source = stash_sender;
+    for (off = 0; off < used; off += 4 + ((len + 3) & ~3)) {
+        memcpy(&len, stash + off, 4);
+        _tuio_packet(pInfo, stash + off + 4, len, wall, wall);
+    }
+
+    return n < MAX_BACKLOG_DROP;
+}
+
+/**
+ * Reads what was left queued by a TuioReadInput() call that ran out of
+ * budget
+ */
+static CARD32
+_resume_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    InputInfoPtr pInfo = arg;
+    int sigstate;
+
+    sigstate = xf86BlockSIGIO();
+    if (pInfo->fd != -1)
+        TuioReadInput(pInfo);
+    xf86UnblockSIGIO(sigstate);
+
+    return 0;
+}
+
+/**
+ * Commits a complete frame: posts pending changes.  Dead objects are
+ * already gone, they are released by the alive message.  Frames older
+ * than MaxFrameAge only post their state transitions; their motion is
+ * dropped.
+ */
+static void
+_frame_commit(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr obj;
+    int num_objects = 0;
+    Bool held = False;
+    CARD32 start, events, age;
+
+    start = _time_us();
+    events = pTuio->stats[TUIO_STAT_EVENTS];
+
+    /* Time since the first packet of the frame arrived, plus the time
+     * the tracker took to get it to us */
+    age = start - pTuio->frame_start + pTuio->frame_net_age;
+    pTuio->stats[TUIO_STAT_FRAME_AGE_US] = age;
+    pTuio->drop_motion = pTuio->max_frame_age > 0 &&
+                         age > pTuio->max_frame_age * 1000;
+    if (pTuio->drop_motion)
+        pTuio->stats[TUIO_STAT_AGED_FRAMES]++;
+
+    for (obj = pTuio->obj_list; obj != NULL; obj = obj->next) {
+        /* Map the new positions of the frame to valuators in one go */
+        if (obj->pending.set)
+            _transform_apply(pTuio, obj);
+
+        /* New objects get a subdevice once the whole frame is in,
+         * so the region filter sees all touches that came down
+         * together */
+        if (obj->fresh) {
+            obj->fresh = False;
+            if (pTuio->grid && _grid_reject(pTuio, obj)) {
+                obj->rejected = True;
+                pTuio->stats[TUIO_STAT_REJECTED]++;
+            } else {
+                obj->subdev = _subdev_get(pInfo, &pTuio->subdev_list);
+                if (obj->subdev && pTuio->post_button_events)
+                    obj->pending.button = True;
+            }
+        }
+    }
+
+    /* The gesture state is that of this frame before any touch is posted,
+     * so the touch left when the other one lifts moves in this frame */
+    if (pTuio->gestures)
+        _gesture_update(pInfo);
+
+    for (obj = pTuio->obj_list; obj != NULL; obj = obj->next) {
+        /* Check to see if an update has been set.  If it has been
+         * updated and it has a subdevice to send events on, send the
+         * event */
+        _object_post(pTuio, obj);
+        held |= obj->dirty;
+        num_objects++;
+    }
+    pTuio->drop_motion = False;
+
+    if (held)
+        _flush_schedule(pInfo);
+
+    if (pTuio->stats[TUIO_STAT_EVENTS] != events)
+        pTuio->stats[TUIO_STAT_OUTPUT_FRAMES]++;
+
+    pTuio->fseq_old = pTuio->fseq_new;
+    pTuio->stats[TUIO_STAT_FRAMES]++;
+    pTuio->stats[TUIO_STAT_OBJECTS] = num_objects;
+    if (pTuio->shm)
+        _shm_publish(pTuio);
+
+    pTuio->stats[TUIO_STAT_COMMIT_US] += _time_us() - start;
+    _latency_add(pTuio, _time_us() - pTuio->frame_start);
+}
+
+/**
+ * Creates the lo_server for the transport.  For the datagram transports
+ * its socket is the one packets are read from.  Stream transports and
+ * Listen endpoints only use it to parse packets; it is bound to a unix
+ * socket in a private directory that is removed right away, so nothing
+ * can send to it, and nobody can take the path from us beforehand.
+ */
+static lo_server
+_server_new(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    lo_server server;
+    char dir[] = "/tmp/.tuio-XXXXXX";
+    char *path;
+
+    switch (pTuio->transport) {
+        case TRANSPORT_UDP:
+            if (pTuio->num_endpoints > 0)
+                break; /* Our own sockets, see _endpoints_open() */
+            asprintf(&path, "%i", pTuio->tuio_port);
+            if (pTuio->mcast_group)
+                server = lo_server_new_multicast(pTuio->mcast_group, path,
+                                                 _lo_error);
+            else
+                server = lo_server_new_with_proto(path, LO_UDP, _lo_error);
+            free(path);
+            return server;
+
+        case TRANSPORT_UNIX:
+            /* A socket left behind by a previous server would make the
+             * bind fail */
+            unlink(pTuio->transport_path);
+            return lo_server_new_with_proto(pTuio->transport_path, LO_UNIX,
+                                            _lo_error);
+    }
+
+    /* Only we can create or connect to sockets in it */
+    if (mkdtemp(dir) == NULL)
+        return NULL;
+
+    asprintf(&path, "%s/parse", dir);
+    server = lo_server_new_with_proto(path, LO_UNIX, _lo_error);
+    unlink(path);
+    rmdir(dir);
+    free(path);
+    return server;
+}
+
+/**
+ * Opens the socket stream trackers connect to.
+ *
+ * @return the listening socket, or -1 on error
+ */
+static int
+_stream_listen(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct sockaddr_in sin;
+    struct sockaddr_un sun;
+    struct sockaddr *addr;
+    socklen_t addrlen;
+    int fd, on = 1;
+
+    if (pTuio->transport == TRANSPORT_TCP) {
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_ANY);
+        sin.sin_port = htons(pTuio->tuio_port);
+        addr = (struct sockaddr *)&sin;
+        addrlen = sizeof(sin);
+    } else {
+        if (strlen(pTuio->transport_path) >= sizeof(sun.sun_path))
+            return -1;
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, pTuio->transport_path);
+        addr = (struct sockaddr *)&sun;
+        addrlen = sizeof(sun);
+        unlink(pTuio->transport_path);
+    }
+
+    SYSCALL(fd = socket(addr->sa_family, SOCK_STREAM, 0));
+    if (fd == -1)
+        return -1;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, addr, addrlen) == -1 || listen(fd, MAX_STREAMS) == -1 ||
+        fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Adds a socket to the sources of a core device
+ */
+static SourcePtr
+_source_add(InputInfoPtr pInfo, int type, int fd)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct epoll_event ev;
+    SourcePtr src;
+
+    src = xcalloc(1, sizeof(SourceRec));
+    src->type = type;
+    src->fd = fd;
+    src->endpoint = -1;
+    if (type == SOURCE_STREAM)
+        src->buf = xalloc(TUIO_MAX_PACKET + 4);
+
+    if (pTuio->epoll_fd != -1) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = src;
+        epoll_ctl(pTuio->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    src->next = pTuio->sources;
+    pTuio->sources = src;
+
+    return src;
+}
+
+/**
+ * Removes a source and closes its socket, unless it belongs to liblo
+ * (the datagram socket of a transport without Listen endpoints)
+ */
+static void
+_source_remove(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    SourcePtr *prev, sender;
+
+    while ((sender = src->senders) != NULL) {
+        src->senders = sender->next;
+        _source_unref(pTuio, sender);
+        xfree(sender);
+    }
+    _source_unref(pTuio, src);
+
+    for (prev = &pTuio->sources; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == src) {
+            *prev = src->next;
+            break;
+        }
+    }
+
+    if (pTuio->epoll_fd != -1)
+        epoll_ctl(pTuio->epoll_fd, EPOLL_CTL_DEL, src->fd, NULL);
+
+    if (src->type == SOURCE_STREAM)
+        pTuio->num_streams--;
+    if (src->type != SOURCE_DGRAM || src->endpoint >= 0)
+        close(src->fd);
+
+    xfree(src->buf);
+    xfree(src);
+}
+
+/**
+ * Forgets a source that is going away: its objects no longer belong to
+ * a source
+ */
+static void
+_source_unref(TuioDevicePtr pTuio, SourcePtr src)
+{
+    ObjectPtr obj;
+
+    for (obj = pTuio->obj_list; obj != NULL; obj = obj->next) {
+        if (obj->source == src)
+            obj->source = NULL;
+    }
+    if (pTuio->source == src)
+        pTuio->source = NULL;
+}
+
+/**
+ * Finds the source of the tracker that sent a datagram to src, and adds
+ * it if it is new.  Once MAX_SENDERS are known, the one that has been
+ * silent for longest is reused, and its touches are released.
+ *
+ * @return the sender, or src itself if it can't be allocated
+ */
+static SourcePtr
+_sender_get(InputInfoPtr pInfo, SourcePtr src,
+            struct sockaddr_storage *addr, socklen_t addrlen)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    SourcePtr *prev, *last = NULL, sender;
+
+    if (addrlen > sizeof(*addr))
+        addrlen = sizeof(*addr);
+
+    for (prev = &src->senders; (sender = *prev) != NULL;
+         prev = &sender->next) {
+        if (sender->addrlen == addrlen &&
+            memcmp(&sender->addr, addr, addrlen) == 0) {
+            *prev = sender->next;
+            sender->next = src->senders;
+            src->senders = sender;
+            return sender;
+        }
+        last = prev;
+    }
+
+    if (src->num_senders == MAX_SENDERS) {
+        sender = *last;
+        *last = NULL;
+        _source_release(pInfo, sender);
+        _source_unref(pTuio, sender);
+        memset(sender, 0, sizeof(SourceRec));
+    } else if ((sender = xcalloc(1, sizeof(SourceRec))) != NULL) {
+        src->num_senders++;
+    } else {
+        return src;
+    }
+
+    sender->type = SOURCE_SENDER;
+    sender->fd = -1;
+    sender->endpoint = src->endpoint;
+    memcpy(&sender->addr, addr, addrlen);
+    sender->addrlen = addrlen;
+
+    sender->next = src->senders;
+    src->senders = sender;
+    return sender;
+}
+
+/**
+ * Accepts trackers connecting to a stream transport
+ */
+static void
+_stream_accept(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    int fd;
+
+    for (;;) {
+        SYSCALL(fd = accept(src->fd, NULL, NULL));
+        if (fd == -1)
+            return;
+
+        /* Producers of the ingest ring only come for its fds */
+        if (pTuio->transport == TRANSPORT_SHM) {
+            _ring_handshake(pInfo, fd);
+            close(fd);
+            continue;
+        }
+
+        if (pTuio->num_streams == MAX_STREAMS ||
+            fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+            xf86Msg(X_WARNING, "%s: Refusing tracker connection\n",
+                    pInfo->name);
+            close(fd);
+            continue;
+        }
+
+        xf86Msg(X_INFO, "%s: Tracker connected\n", pInfo->name);
+        _source_add(pInfo, SOURCE_STREAM, fd)->endpoint = src->endpoint;
+        pTuio->num_streams++;
+    }
+}
+
+/**
+ * Reads from a tracker connected to a stream transport, and handles the
+ * complete packets received.  Each packet is preceded by its size as a
+ * 32 bit big endian integer, like OSC 1.0 over stream transports.
+ */
+static void
+_stream_read(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct timespec now;
+    int64_t wall;
+    uint32_t size;
+    int len, room, off = 0;
+
+    src->backlog = False;
+
+    /* A full buffer holds a complete packet left by the read budget, which
+     * is handled before anything more is read */
+    room = TUIO_MAX_PACKET + 4 - src->len;
+    if (room > 0) {
+        SYSCALL(len = read(src->fd, src->buf + src->len, room));
+        if (len == 0 || (len == -1 && errno != EAGAIN)) {
+            xf86Msg(X_INFO, "%s: Tracker disconnected\n", pInfo->name);
+            _source_release(pInfo, src);
+            _source_remove(pInfo, src);
+            return;
+        }
+        if (len > 0)
+            src->len += len;
+    }
+
+    /* No kernel timestamps on streams, packets arrive now */
+    clock_gettime(CLOCK_REALTIME, &now);
+    wall = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+    while (src->len - off >= 4) {
+        memcpy(&size, src->buf + off, 4);
+        size = ntohl(size);
+        if (size == 0 || size > TUIO_MAX_PACKET) {
+            xf86Msg(X_WARNING, "%s: Bad packet size %u, dropping tracker\n",
+                    pInfo->name, size);
+            _source_release(pInfo, src);
+            _source_remove(pInfo, src);
+            return;
+        }
+        if (src->len - off - 4 < size)
+            break;
+
+        if (_read_budget_done(pTuio)) {
+            _backlog(pInfo, src);
+            break;
+        }
+        pTuio->read_packets++;
+
+        _tuio_packet(pInfo, src->buf + off + 4, size, wall, wall);
+        off += 4 + size;
+    }
+
+    /* Keep the start of an incomplete packet */
+    if (off > 0) {
+        memmove(src->buf, src->buf + off, src->len - off);
+        src->len -= off;
+    }
+}
+
+/**
+ * Creates the shared memory ingest ring and the eventfd its producer
+ * signals new packets on.  Both are anonymous, the producer gets them
+ * through _ring_handshake().
+ */
+static int
+_ring_open(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    size_t size = sizeof(TuioRingHeader) + TUIO_RING_SIZE;
+    char *path;
+
+    asprintf(&path, "/tuio-ring-%i-%p", (int)getpid(), pTuio);
+    pTuio->ring_fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (pTuio->ring_fd != -1)
+        shm_unlink(path);
+    free(path);
+    if (pTuio->ring_fd == -1)
+        return BadAlloc;
+
+    if (ftruncate(pTuio->ring_fd, size) == -1 ||
+        (pTuio->ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            pTuio->ring_fd, 0)) == MAP_FAILED) {
+        pTuio->ring = NULL;
+        _ring_close(pTuio);
+        return BadAlloc;
+    }
+
+    pTuio->ring->magic = TUIO_RING_MAGIC;
+    pTuio->ring->version = TUIO_RING_VERSION;
+    pTuio->ring->size = TUIO_RING_SIZE;
+    pTuio->ring_dropped = 0;
+
+    SYSCALL(pTuio->ring_event = eventfd(0, EFD_NONBLOCK));
+    if (pTuio->ring_event == -1) {
+        _ring_close(pTuio);
+        return BadAlloc;
+    }
+    _source_add(pInfo, SOURCE_RING, pTuio->ring_event);
+
+    return Success;
+}
+
+/**
+ * Sends the ring and its eventfd to a producer that connected.  Once the
+ * ring has been closed after an error, producers are refused.
+ */
+static void
+_ring_handshake(InputInfoPtr pInfo, int fd)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    int fds[2];
+    char byte = 0;
+
+    if (pTuio->ring == NULL || pTuio->ring_event == -1) {
+        xf86Msg(X_WARNING, "%s: No ingest ring, refusing tracker\n",
+                pInfo->name);
+        return;
+    }
+
+    fds[0] = pTuio->ring_fd;
+    fds[1] = pTuio->ring_event;
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) == 1)
+        xf86Msg(X_INFO, "%s: Ingest ring handed to a tracker\n",
+                pInfo->name);
+    else
+        xf86Msg(X_WARNING, "%s: Unable to hand the ingest ring to a "
+                "tracker\n", pInfo->name);
+}
+
+/**
+ * Handles the packets the producer has put into the ingest ring.  Each
+ * packet is copied out of the ring before it is parsed, so a producer
+ * writing to it can't change a packet under liblo.
+ */
+static void
+_ring_read(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    TuioRingHeader *ring = pTuio->ring;
+    char *data = (char *)(ring + 1);
+    struct timespec now;
+    uint64_t events;
+    uint32_t head, tail, off, len;
+    int64_t wall;
+    int res;
+
+    src->backlog = False;
+
+    /* Reset the eventfd before looking at head, so a packet added after
+     * this wakes us again.  It has no events if we are resuming from
+     * a backlog. */
+    SYSCALL(res = read(src->fd, &events, sizeof(events)));
+    if (res == -1 && errno != EAGAIN) {
+        xf86Msg(X_WARNING, "%s: Unable to read the ingest ring eventfd "
+                "(%s), closing it\n", pInfo->name, strerror(errno));
+        _source_release(pInfo, src);
+        _source_remove(pInfo, src);
+        _ring_close(pTuio);
+        return;
+    }
+
+    pTuio->stats[TUIO_STAT_KERNEL_DROPS] += ring->dropped - pTuio->ring_dropped;
+    pTuio->ring_dropped = ring->dropped;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    wall = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+    head = ring->head;
+    __sync_synchronize();
+    tail = ring->tail;
+
+    /* Everything the producer says is checked against the ring, a
+     * broken producer must not make us read outside of it */
+    if (head - tail > TUIO_RING_SIZE)
+        goto corrupt;
+
+    while (tail != head) {
+        if (_read_budget_done(pTuio)) {
+            _backlog(pInfo, src);
+            break;
+        }
+
+        off = tail & (TUIO_RING_SIZE - 1);
+        memcpy(&len, data + off, 4);
+
+        if (len == TUIO_RING_WRAP) {
+            if (off == 0 || TUIO_RING_SIZE - off > head - tail)
+                goto corrupt;
+            tail += TUIO_RING_SIZE - off;
+            continue;
+        }
+
+        if (len == 0 || len > TUIO_MAX_PACKET ||
+            off + TUIO_RING_RECORD(len) > TUIO_RING_SIZE ||
+            TUIO_RING_RECORD(len) > head - tail)
+            goto corrupt;
+
+        memcpy(pTuio->recv_buf, data + off + 4, len);
+        tail += TUIO_RING_RECORD(len);
+        pTuio->read_packets++;
+
+        _tuio_packet(pInfo, pTuio->recv_buf, len, wall, wall);
+    }
+
+    __sync_synchronize();
+    ring->tail = tail;
+    return;
+
+corrupt:
+    xf86Msg(X_WARNING, "%s: Corrupt ingest ring, discarding its contents\n",
+            pInfo->name);
+    __sync_synchronize();
+    ring->tail = head;
+}
+
+/**
+ * Unmaps the ingest ring.  The eventfd is closed with its source.
+ */
+static void
+_ring_close(TuioDevicePtr pTuio)
+{
+    if (pTuio->ring)
+        munmap(pTuio->ring, sizeof(TuioRingHeader) + TUIO_RING_SIZE);
+    if (pTuio->ring_fd != -1)
+        close(pTuio->ring_fd);
+    pTuio->ring = NULL;
+    pTuio->ring_fd = -1;
+    pTuio->ring_event = -1;
+}
+
+/**
+ * Reads one datagram from a source and handles it as a packet.  The kernel
+ * receive time is passed on, so the age of the frame the packet belongs to
+ * is known at commit time.
+ *
+ * @return the packet size, or <= 0 if nothing was read
+ */
+static int
+_tuio_recv(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(struct timespec)) +
+                 CMSG_SPACE(sizeof(uint32_t))];
+    struct sockaddr_storage addr;
+    struct timespec now;
+    int64_t rx = 0, wall;
+    int len;
+
+    iov.iov_base = pTuio->recv_buf;
+    iov.iov_len = TUIO_MAX_PACKET;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    SYSCALL(len = recvmsg(src->fd, &msg, MSG_DONTWAIT));
+    if (len <= 0)
+        return len;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    wall = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+#ifdef SO_TIMESTAMPNS
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            rx = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        }
+#ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t dropped;
+
+            /* Total packets dropped by the socket so far */
+            memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+            pTuio->stats[TUIO_STAT_KERNEL_DROPS] += dropped - src->rxq_dropped;
+            if (src->endpoint >= 0)
+                pTuio->endpoint_stats[src->endpoint * TUIO_LISTEN_STAT_COUNT +
+                                      TUIO_LISTEN_DROPS] +=
+                    dropped - src->rxq_dropped;
+            src->rxq_dropped = dropped;
+        }
+#endif
+    }
+#endif
+    if (rx == 0 || rx > wall)
+        rx = wall;
+
+    pTuio->source = _sender_get(pInfo, src, &addr, msg.msg_namelen);
+    _tuio_packet(pInfo, pTuio->recv_buf, len, rx, wall);
+
+    return len;
+}
+
+/**
+ * Tracks the offset between the clock of the tracker sending to a source
+ * and ours.  The smallest offset seen over a window of bundles is taken
+ * as the offset of a bundle that wasn't delayed, and the change between
+ * windows gives the drift of the tracker clock.  The statistics show the
+ * estimate of the source that last completed a window.
+ *
+ * @return how much later than an undelayed bundle this one arrived
+ */
+static CARD32
+_clock_update(TuioDevicePtr pTuio, SourcePtr src, int64_t rx,
+              int64_t timetag)
+{
+    int64_t offset = rx - timetag;
+    int64_t estimate;
+
+    if (src->clock.window_count == 0 || offset < src->clock.window_min)
+        src->clock.window_min = offset;
+
+    if (++src->clock.window_count == CLOCK_WINDOW) {
+        if (src->clock.valid && rx > src->clock.time)
+            src->clock.drift = (double)(src->clock.window_min -
+                                        src->clock.offset) /
+                               (rx - src->clock.time);
+        src->clock.offset = src->clock.window_min;
+        src->clock.time = rx;
+        src->clock.valid = True;
+        src->clock.window_count = 0;
+
+        pTuio->stats[TUIO_STAT_CLOCK_OFFSET_MS] =
+            (CARD32)(src->clock.offset / 1000);
+        pTuio->stats[TUIO_STAT_CLOCK_DRIFT_PPM] =
+            (CARD32)(int)(src->clock.drift * 1000000);
+    }
+
+    if (src->clock.valid)
+        estimate = src->clock.offset +
+                   (int64_t)(src->clock.drift * (rx - src->clock.time));
+    else
+        estimate = src->clock.window_min;
+
+    return offset > estimate ? (CARD32)(offset - estimate) : 0;
+}
+
+/**
+ * Handle device state changes
+ */
+static int
+TuioControl(DeviceIntPtr device,
+            int what)
+{
+    InputInfoPtr pInfo = device->public.devicePrivate;
+    TuioDevicePtr pTuio = NULL, pCore;
+    SubDevicePtr subdev;
+    CARD32 resume = 0;
+    int res;
+
+    if (IS_CORE_DEVICE(pInfo)) {
+        pTuio = pInfo->private;
+        subdev = pTuio->core_subdev;
+    } else {
+        subdev = pInfo->private;
+    }
+
+    switch (what)
+    {
+        case DEVICE_INIT:
+            xf86Msg(X_INFO, "%s: Init\n", pInfo->name);
+            _init_buttons(device);
+            _init_axes(device);
+
+            /* If this is a "core" device, create object devices */
+            if (pTuio) {
+                TuioPropertyInit(device);
+                _hal_create_devices(pInfo, pTuio->init_num_subdev);
+            }
+            break;
+
+        case DEVICE_ON: /* Open socket and start listening! */
+            xf86Msg(X_INFO, "%s: On.\n", pInfo->name);
+            if (device->public.on)
+                break;
+
+            /* If this is an object device, use the dummy pipe of its
+             * core device, and add device to subdev list */
+            if (!pTuio) {
+                if (subdev->core == NULL) {
+                    xf86Msg(X_ERROR, "%s: TUIO core device is gone\n",
+                            pInfo->name);
+                    return BadMatch;
+                }
+
+                pCore = subdev->core->private;
+                if (pCore->subdev_pipe[0] == -1) {
+                    SYSCALL(res = pipe(pCore->subdev_pipe));
+                    if (res == -1) {
+                        xf86Msg(X_ERROR, "%s: failed to open pipe\n",
+                                pInfo->name);
+                        return BadAlloc;
+                    }
+                }
+
+                pInfo->fd = pCore->subdev_pipe[0];
+
+                goto finish;
+            }
+
+            /* A suspended device kept its sockets, they only need to be
+             * enabled again */
+            if (pTuio->server) {
+                resume = _time_us();
+                TimerCancel(pTuio->drain_timer);
+                _drain(pInfo);
+                pTuio->suspended = False;
+            } else {
+                res = _transport_open(pInfo);
+                if (res != Success)
+                    return res;
+            }
+
+            if (pTuio->shm_name && !pTuio->shm)
+                _shm_open(pInfo);
+
+            pTuio->flush_due = _time_us();
+            if (pTuio->obj_list)
+                _watchdog_arm(pInfo);
+
+finish:     if (pTuio && pTuio->epoll_fd != -1)
+                AddEnabledDevice(pInfo->fd); /* epoll can't do SIGIO */
+            else
+                xf86AddEnabledDevice(pInfo);
+            device->public.on = TRUE;
+
+            if (resume)
+                xf86Msg(X_INFO, "%s: Resumed in %u us\n", pInfo->name,
+                        (unsigned int)(_time_us() - resume));
+
+            /* Add to the device list of the core device.  A parked
+             * subdevice is already in it; it is not parked any more,
+             * whoever enabled it (the server does so on a VT switch).
+             * If it is idle, it is parked again later. */
+            if (subdev->parked) {
+                subdev->parked = False;
+                subdev->idle_since = GetTimeInMillis();
+                _subdev_queue_parking(subdev->core);
+            } else {
+                _subdev_add(subdev->core, subdev);
+            }
+            break;
+
+        case DEVICE_OFF:
+            xf86Msg(X_INFO, "%s: Off\n", pInfo->name);
+            if (!device->public.on)
+                break;
+
+            if (pTuio && pTuio->epoll_fd != -1)
+                RemoveEnabledDevice(pInfo->fd);
+            else
+                xf86RemoveEnabledDevice(pInfo);
+
+            /* The sockets stay open, see _suspend() */
+            if (pTuio)
+                _suspend(pInfo);
+            /* Remove subdev from list - This applies for both subdevices
+             * and the "core" device.  Parked subdevices stay in the list. */
+            if (subdev->core && !subdev->parked)
+                _subdev_remove(subdev->core, pInfo);
+
+            device->public.on = FALSE;
+            break;
+
+        case DEVICE_CLOSE:
+            xf86Msg(X_INFO, "%s: Close\n", pInfo->name);
+            if (pTuio)
+                _subdev_cancel_parking(pInfo);
+            if (pTuio && pTuio->server)
+                _transport_close(pInfo);
+            _hal_remove_device(pInfo);
+            break;
+
+    }
+    return Success;
+}
+
+/**
+ * Opens the sockets of the transport, which stay open until the device
+ * is closed
+ */
+static int
+_transport_open(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    int fd;
+
+    /* Setup server */
+    pTuio->server = _server_new(pInfo);
+    if (pTuio->server == NULL) {
+        xf86Msg(X_ERROR, "%s: Error allocating new lo_server\n", 
+                pInfo->name);
+        return BadAlloc;
+    }
+
+    /* Register to receive all /tuio/2Dcur messages */
+    lo_server_add_method(pTuio->server, "/tuio/2Dcur", NULL, 
+                         _tuio_lo_2dcur_handle, pInfo);
+
+    if (pTuio->num_endpoints > 0)
+        return _endpoints_open(pInfo);
+
+    if (pTuio->transport == TRANSPORT_UDP ||
+        pTuio->transport == TRANSPORT_UNIX) {
+        /* liblo's socket is read directly */
+        pInfo->fd = lo_server_get_socket_fd(pTuio->server);
+
+        if (pTuio->transport == TRANSPORT_UDP &&
+            pTuio->mcast_group && pTuio->mcast_iface)
+            _multicast_iface(pInfo, pInfo->fd);
+
+        _socket_setup(pInfo, pInfo->fd);
+
+        xf86FlushInput(pInfo->fd);
+        _source_add(pInfo, SOURCE_DGRAM, pInfo->fd);
+    } else {
+        /* Trackers connect to our own socket, liblo only parses */
+        SYSCALL(pTuio->epoll_fd = epoll_create(MAX_STREAMS + 1));
+        fd = _stream_listen(pInfo);
+        if (pTuio->epoll_fd == -1 || fd == -1) {
+            xf86Msg(X_ERROR, "%s: Unable to listen for trackers\n",
+                    pInfo->name);
+            if (pTuio->epoll_fd != -1)
+                close(pTuio->epoll_fd);
+            pTuio->epoll_fd = -1;
+            lo_server_free(pTuio->server);
+            pTuio->server = NULL;
+            return BadAlloc;
+        }
+        _source_add(pInfo, SOURCE_LISTEN, fd);
+        pInfo->fd = pTuio->epoll_fd;
+
+        if (pTuio->transport == TRANSPORT_SHM &&
+            _ring_open(pInfo) != Success) {
+            xf86Msg(X_ERROR, "%s: Unable to create the ingest ring\n",
+                    pInfo->name);
+            while (pTuio->sources)
+                _source_remove(pInfo, pTuio->sources);
+            close(pTuio->epoll_fd);
+            pTuio->epoll_fd = -1;
+            lo_server_free(pTuio->server);
+            pTuio->server = NULL;
+            return BadAlloc;
+        }
+    }
+
+    return Success;
+}
+
+/**
+ * Closes the sockets of the transport
+ */
+static void
+_transport_close(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+
+    if (pTuio->drain_timer)
+        TimerCancel(pTuio->drain_timer);
+    if (pTuio->resume_timer)
+        TimerCancel(pTuio->resume_timer);
+    while (pTuio->sources)
+        _source_remove(pInfo, pTuio->sources);
+    if (pTuio->epoll_fd != -1) {
+        close(pTuio->epoll_fd);
+        pTuio->epoll_fd = -1;
+    }
+    lo_server_free(pTuio->server);
+    pTuio->server = NULL;
+    _ring_close(pTuio);
+    if (pTuio->transport == TRANSPORT_UNIX_STREAM ||
+        pTuio->transport == TRANSPORT_SHM)
+        unlink(pTuio->transport_path);
+    pInfo->fd = -1;
+}
+
+/**
+ * Suspends a core device that is turned off: its touches are released,
+ * with no events on subdevices that are already off, and packets
+ * arriving are read and discarded from a timer until it is turned on
+ * again, so it doesn't resume with a backlog of stale frames.
+ */
+static void
+_suspend(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr obj;
+
+    if (pTuio->flush_timer)
+        TimerCancel(pTuio->flush_timer);
+    pTuio->flush_armed = False;
+    if (pTuio->watchdog_timer)
+        TimerCancel(pTuio->watchdog_timer);
+    pTuio->watchdog_armed = False;
+
+    while ((obj = pTuio->obj_list) != NULL) {
+        pTuio->obj_list = obj->next;
+        obj->next = NULL;
+        _object_release(pInfo, obj);
+    }
+    pTuio->frame_started = False;
+
+    pTuio->suspended = True;
+    pTuio->drain_timer = TimerSet(pTuio->drain_timer, 0, DRAIN_INTERVAL,
+                                  _drain_timer, pInfo);
+}
+
+/**
+ * Reads and discards the packets arriving while the device is off
+ */
+static CARD32
+_drain_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    InputInfoPtr pInfo = arg;
+    int sigstate;
+
+    sigstate = xf86BlockSIGIO();
+    TuioReadInput(pInfo);
+    xf86UnblockSIGIO(sigstate);
+
+    return DRAIN_INTERVAL;
+}
+
+/**
+ * Discards the packets queued since the last run of _drain_timer(), so
+ * a resumed device starts from the next frame.  Must be called while the
+ * device is still suspended.
+ */
+static void
+_drain(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    int budget = pTuio->read_budget;
+    int time = pTuio->read_time;
+    int sigstate;
+
+    pTuio->read_budget = MAX_BACKLOG_DROP;
+    pTuio->read_time = 0;
+    sigstate = xf86BlockSIGIO();
+    TuioReadInput(pInfo);
+    xf86UnblockSIGIO(sigstate);
+    pTuio->read_budget = budget;
+    pTuio->read_time = time;
+}
+
+/**
+ * Parses the space or comma separated IPv4 addresses of AllowedSources
+ */
+static void
+_parse_sources(InputInfoPtr pInfo, const char *name, char *sources)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct in_addr addr;
+    char *tok, *save;
+
+    for (tok = strtok_r(sources, " ,", &save); tok != NULL;
+         tok = strtok_r(NULL, " ,", &save)) {
+        if (pTuio->num_allowed_sources == TUIO_MAX_SOURCES) {
+            xf86Msg(X_WARNING, "%s: Too many AllowedSources, ignoring %s\n",
+                    name, tok);
+            continue;
+        }
+        if (inet_pton(AF_INET, tok, &addr) != 1) {
+            xf86Msg(X_WARNING, "%s: Invalid source address %s\n",
+                    name, tok);
+            continue;
+        }
+        pTuio->allowed_sources[pTuio->num_allowed_sources++] =
+            ntohl(addr.s_addr);
+    }
+
+    if (pTuio->num_allowed_sources > 0 && !pTuio->socket_filter) {
+        xf86Msg(X_INFO, "%s: AllowedSources enables SocketFilter\n", name);
+        pTuio->socket_filter = True;
+    }
+}
+
+/**
+ * Parses the space or comma separated address:port endpoints of Listen.
+ * IPv6 addresses are given in brackets; an empty or "*" address is any
+ * IPv4 address.
+ */
+static void
+_parse_endpoints(InputInfoPtr pInfo, const char *name, char *endpoints)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct addrinfo hints, *res;
+    char *tok, *save, *host, *port;
+    int i;
+
+    for (tok = strtok_r(endpoints, " ,", &save); tok != NULL;
+         tok = strtok_r(NULL, " ,", &save)) {
+        i = pTuio->num_endpoints;
+        if (i == MAX_ENDPOINTS) {
+            xf86Msg(X_WARNING, "%s: Too many Listen endpoints, ignoring %s\n",
+                    name, tok);
+            continue;
+        }
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV | AI_PASSIVE;
+        hints.ai_socktype = pTuio->transport == TRANSPORT_TCP ?
+                            SOCK_STREAM : SOCK_DGRAM;
+
+        /* Split at the last colon, the address may have some too */
+        host = xstrdup(tok);
+        port = strrchr(host, ':');
+        if (port == NULL || port[1] == '\0') {
+            xf86Msg(X_WARNING, "%s: Invalid Listen endpoint %s\n", name, tok);
+            xfree(host);
+            continue;
+        }
+        *port++ = '\0';
+        if (host[0] == '[' && port - host >= 3 && port[-2] == ']') {
+            port[-2] = '\0';
+            hints.ai_family = AF_INET6;
+        } else if (host[0] == '\0' || strcmp(host, "*") == 0) {
+            hints.ai_family = AF_INET;
+        }
+
+        if (getaddrinfo(hints.ai_family == AF_INET6 ? host + 1 :
+                        hints.ai_family == AF_INET ? NULL : host,
+                        port, &hints, &res) != 0) {
+            xf86Msg(X_WARNING, "%s: Invalid Listen endpoint %s\n", name, tok);
+            xfree(host);
+            continue;
+        }
+        memcpy(&pTuio->endpoints[i], res->ai_addr, res->ai_addrlen);
+        pTuio->endpoint_lens[i] = res->ai_addrlen;
+        freeaddrinfo(res);
+        xfree(host);
+
+        pTuio->endpoint_names[i] = xstrdup(tok);
+        pTuio->num_endpoints++;
+        xf86Msg(X_INFO, "%s: Listening on %s\n", name, tok);
+    }
+}
+
+/**
+ * Opens a socket on each Listen endpoint.  All of them are read through
+ * the epoll fd, so one wakeup services every endpoint that is ready.
+ * Endpoints that can't be bound are skipped.
+ */
+static int
+_endpoints_open(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct sockaddr *addr;
+    SourcePtr src;
+    Bool stream = pTuio->transport == TRANSPORT_TCP;
+    int i, fd, n = 0, on = 1;
+
+    SYSCALL(pTuio->epoll_fd = epoll_create(MAX_STREAMS + MAX_ENDPOINTS));
+    if (pTuio->epoll_fd == -1) {
+        lo_server_free(pTuio->server);
+        pTuio->server = NULL;
+        return BadAlloc;
+    }
+
+    for (i = 0; i < pTuio->num_endpoints; i++) {
+        addr = (struct sockaddr *)&pTuio->endpoints[i];
+        SYSCALL(fd = socket(addr->sa_family,
+                            stream ? SOCK_STREAM : SOCK_DGRAM, 0));
+        if (fd == -1)
+            continue;
+
+        /* So [::] and 0.0.0.0 can both be bound to the same port */
+        if (addr->sa_family == AF_INET6)
+            setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on));
+        if (stream)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        if (bind(fd, addr, pTuio->endpoint_lens[i]) == -1 ||
+            (stream && listen(fd, MAX_STREAMS) == -1) ||
+            fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+            xf86Msg(X_ERROR, "%s: Unable to listen on %s: %s\n",
+                    pInfo->name, pTuio->endpoint_names[i], strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        if (stream) {
+            src = _source_add(pInfo, SOURCE_LISTEN, fd);
+        } else {
+            _socket_setup(pInfo, fd);
+            src = _source_add(pInfo, SOURCE_DGRAM, fd);
+        }
+        src->endpoint = i;
+        n++;
+    }
+
+    if (n == 0) {
+        close(pTuio->epoll_fd);
+        pTuio->epoll_fd = -1;
+        lo_server_free(pTuio->server);
+        pTuio->server = NULL;
+        return BadAlloc;
+    }
+
+    pInfo->fd = pTuio->epoll_fd;
+    return Success;
+}
+
+/**
+ * Moves the multicast group membership liblo made on the default interface
+ * to MulticastInterface, given as an interface name or address.
+ */
+static void
+_multicast_iface(InputInfoPtr pInfo, int fd)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct ip_mreqn mreq;
+    struct ip_mreq any;
+
+    memset(&mreq, 0, sizeof(mreq));
+    if (inet_pton(AF_INET, pTuio->mcast_group, &mreq.imr_multiaddr) != 1) {
+        xf86Msg(X_WARNING, "%s: Invalid multicast group %s\n",
+                pInfo->name, pTuio->mcast_group);
+        return;
+    }
+
+    if (inet_pton(AF_INET, pTuio->mcast_iface, &mreq.imr_address) != 1 &&
+        (mreq.imr_ifindex = if_nametoindex(pTuio->mcast_iface)) == 0) {
+        xf86Msg(X_WARNING, "%s: Unknown multicast interface %s\n",
+                pInfo->name, pTuio->mcast_iface);
+        return;
+    }
+
+    any.imr_multiaddr = mreq.imr_multiaddr;
+    any.imr_interface.s_addr = htonl(INADDR_ANY);
+    setsockopt(fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &any, sizeof(any));
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                   &mreq, sizeof(mreq)) == -1)
+        xf86Msg(X_WARNING, "%s: Unable to join %s on %s\n",
+                pInfo->name, pTuio->mcast_group, pTuio->mcast_iface);
+    else
+        xf86Msg(X_INFO, "%s: Joined %s on %s\n",
+                pInfo->name, pTuio->mcast_group, pTuio->mcast_iface);
+}
+
+/**
+ * Sets up the socket options of a TUIO socket
+ */
+static void
+_socket_setup(InputInfoPtr pInfo, int fd)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    struct sockaddr_storage addr;
+    int on = 1, size, actual;
+    socklen_t len;
+
+#ifdef SO_TIMESTAMPNS
+    /* Have the kernel tell us when packets arrived */
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == -1)
+        xf86Msg(X_WARNING, "%s: Unable to enable receive timestamps\n",
+                pInfo->name);
+#endif
+
+#ifdef SO_RXQ_OVFL
+    /* Have the kernel tell us how many packets it dropped */
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) == -1)
+        xf86Msg(X_WARNING, "%s: Unable to enable drop counting\n",
+                pInfo->name);
+#endif
+
+    if (pTuio->rcvbuf > 0) {
+        size = pTuio->rcvbuf;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+#ifdef SO_RCVBUFFORCE
+        /* The kernel doubles the value for its bookkeeping; if it is
+         * less than that, we hit rmem_max, which root may exceed */
+        len = sizeof(actual);
+        if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actual, &len) == 0 &&
+            actual < size * 2)
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size));
+#endif
+    }
+
+    len = sizeof(actual);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actual, &len) == 0) {
+        pTuio->stats[TUIO_STAT_RCVBUF] = actual;
+        if (pTuio->rcvbuf > 0)
+            xf86Msg(actual < pTuio->rcvbuf ? X_WARNING : X_INFO,
+                    "%s: Receive buffer is %i bytes (requested %i)\n",
+                    pInfo->name, actual, pTuio->rcvbuf);
+    }
+
+    /* The filter expects UDP headers, AllowedSources IPv4 ones */
+    len = sizeof(addr);
+    if (pTuio->socket_filter && pTuio->transport == TRANSPORT_UDP &&
+        getsockname(fd, (struct sockaddr *)&addr, &len) == 0 &&
+        addr.ss_family == AF_INET)
+        _socket_filter(pInfo, fd);
+}
+
+/* Big endian 32 bit word of four characters, as loaded by BPF */
+#define BPF_WORD(a, b, c, d) \
+    (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+/* Relative jump from instruction "from" to instruction "to" */
+#define BPF_JUMP_TO(from, to) ((to) - (from) - 1)
+
+/**
+ * Attaches a classic BPF filter to the socket that only accepts OSC
+ * bundles whose first element is a /tuio/2Dcur message and /tuio/2Dcur
+ * messages, optionally only from the AllowedSources addresses.  Anything
+ * else is dropped by the kernel, before the X server is woken up.
+ */
+static void
+_socket_filter(InputInfoPtr pInfo, int fd)
+{
+#ifdef SO_ATTACH_FILTER
+    TuioDevicePtr pTuio = pInfo->private;
+    struct sock_filter prog[TUIO_MAX_SOURCES + 20];
+    struct sock_fprog fprog;
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    int num_sources = pTuio->num_allowed_sources;
+    int n = 0, i, match, msg, accept, drop;
+
+    if (num_sources > 0 &&
+        (getsockname(fd, (struct sockaddr *)&addr, &addrlen) == -1 ||
+         addr.ss_family != AF_INET)) {
+        xf86Msg(X_WARNING, "%s: AllowedSources only works on IPv4 "
+                "sockets, ignoring it\n", pInfo->name);
+        num_sources = 0;
+    }
+
+    /* Layout of the program, offsets are relative to the UDP header */
+    match = 2 + (num_sources ? num_sources + 1 : 0);
+    msg = match + 10;
+    accept = msg + 5;
+    drop = accept + 1;
+
+    /* Needs at least the UDP header and a 12 byte address */
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_LEN, 0);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JGE|BPF_K, 20,
+                                           0, BPF_JUMP_TO(n, drop));
+    n++;
+
+    if (num_sources) {
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+                                                 SKF_NET_OFF + 12);
+        for (i = 0; i < num_sources; i++, n++)
+            prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+                    pTuio->allowed_sources[i], BPF_JUMP_TO(n, match),
+                    i == num_sources - 1 ? BPF_JUMP_TO(n, drop) : 0);
+    }
+
+    /* Bundle: "#bundle\0", timetag, size of the first element, then the
+     * address of the first element */
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 8);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('#', 'b', 'u', 'n'), 0, BPF_JUMP_TO(n, msg));
+    n++;
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 12);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('d', 'l', 'e', 0), 0, BPF_JUMP_TO(n, drop));
+    n++;
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 28);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('/', 't', 'u', 'i'), 0, BPF_JUMP_TO(n, drop));
+    n++;
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 32);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('o', '/', '2', 'D'), 0, BPF_JUMP_TO(n, drop));
+    n++;
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 36);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('c', 'u', 'r', 0), BPF_JUMP_TO(n, accept),
+            BPF_JUMP_TO(n, drop));
+    n++;
+
+    /* Message: the first word is still loaded */
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('/', 't', 'u', 'i'), 0, BPF_JUMP_TO(n, drop));
+    n++;
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 12);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('o', '/', '2', 'D'), 0, BPF_JUMP_TO(n, drop));
+    n++;
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS, 16);
+    prog[n] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,
+            BPF_WORD('c', 'u', 'r', 0), BPF_JUMP_TO(n, accept),
+            BPF_JUMP_TO(n, drop));
+    n++;
+
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0xFFFFFFFF);
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0);
+
+    fprog.len = n;
+    fprog.filter = prog;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER,
+                   &fprog, sizeof(fprog)) == -1)
+        xf86Msg(X_WARNING, "%s: Unable to attach socket filter\n",
+                pInfo->name);
+    else
+        xf86Msg(X_INFO, "%s: Socket filter attached (%i allowed sources)\n",
+                pInfo->name, num_sources);
+#else
+    xf86Msg(X_WARNING, "%s: Socket filters are not supported\n",
+            pInfo->name);
+#endif
+}
+
+#if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 3
+/**
+ * Refresh the statistics property right before it is read, so the
+ * counters don't have to be pushed to the property on every frame
+ */
+static int
+_get_property(DeviceIntPtr device,
+              Atom atom)
+{
+    InputInfoPtr pInfo = device->public.devicePrivate;
+    TuioDevicePtr pTuio = pInfo->private;
+
+    /* The change goes through _set_property() like any other */
+    pTuio->updating_props = True;
+    if (atom == pTuio->prop_stats)
+        XIChangeDeviceProperty(device, atom, XA_INTEGER, 32,
+                               PropModeReplace, TUIO_STAT_COUNT,
+                               pTuio->stats, FALSE);
+    else if (atom == pTuio->prop_latency)
+        XIChangeDeviceProperty(device, atom, XA_INTEGER, 32,
+                               PropModeReplace, TUIO_LATENCY_BUCKETS,
+                               pTuio->latency, FALSE);
+    else if (atom == pTuio->prop_listen_stats && pTuio->num_endpoints > 0)
+        XIChangeDeviceProperty(device, atom, XA_INTEGER, 32,
+                               PropModeReplace,
+                               pTuio->num_endpoints * TUIO_LISTEN_STAT_COUNT,
+                               pTuio->endpoint_stats, FALSE);
+    pTuio->updating_props = False;
+    return Success;
+}
+
+/**
+ * Checks and applies a change of a driver property.  The statistics are
+ * read-only for clients, only _get_property() may change them.
+ */
+static int
+_set_property(DeviceIntPtr device,
+              Atom atom,
+              XIPropertyValuePtr val,
+              BOOL checkonly)
+{
+    InputInfoPtr pInfo = device->public.devicePrivate;
+    TuioDevicePtr pTuio = pInfo->private;
+    int sigstate;
+
+    if (atom == pTuio->prop_stats || atom == pTuio->prop_latency ||
+        (atom == pTuio->prop_listen_stats && pTuio->num_endpoints > 0))
+        return pTuio->updating_props ? Success : BadAccess;
+
+    if (atom == pTuio->prop_calibration) {
+        if (val->format != 32 || val->size != 9 ||
+            val->type != XIGetKnownProperty(XATOM_FLOAT))
+            return BadMatch;
+        if (!_transform_check(val->data, pTuio->output_range))
+            return BadValue;
+        if (!checkonly) {
+            /* Packets are transformed from the SIGIO handler */
+            sigstate = xf86BlockSIGIO();
+            _transform_update(pTuio, val->data, pTuio->output_range);
+            xf86UnblockSIGIO(sigstate);
+        }
+    } else if (atom == pTuio->prop_range) {
+        if (val->format != 32 || val->size != 4 || val->type != XA_INTEGER)
+            return BadMatch;
+        if (!_transform_check(pTuio->calibration, val->data))
+            return BadValue;
+        if (!checkonly) {
+            sigstate = xf86BlockSIGIO();
+            _transform_update(pTuio, pTuio->calibration, val->data);
+            xf86UnblockSIGIO(sigstate);
+        }
+    }
+    return Success;
+}
+#endif
+
+/**
+ * Initialize the device properties
+ */
+static void
+TuioPropertyInit(DeviceIntPtr device)
+{
+#if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 3
+    InputInfoPtr pInfo = device->public.devicePrivate;
+    TuioDevicePtr pTuio = pInfo->private;
+
+    pTuio->prop_stats = MakeAtom(TUIO_PROP_STATISTICS,
+                                 strlen(TUIO_PROP_STATISTICS), TRUE);
+    XIChangeDeviceProperty(device, pTuio->prop_stats, XA_INTEGER, 32,
+                           PropModeReplace, TUIO_STAT_COUNT,
+                           pTuio->stats, FALSE);
+    XISetDevicePropertyDeletable(device, pTuio->prop_stats, FALSE);
+
+    pTuio->prop_latency = MakeAtom(TUIO_PROP_LATENCY,
+                                   strlen(TUIO_PROP_LATENCY), TRUE);
+    XIChangeDeviceProperty(device, pTuio->prop_latency, XA_INTEGER, 32,
+                           PropModeReplace, TUIO_LATENCY_BUCKETS,
+                           pTuio->latency, FALSE);
+    XISetDevicePropertyDeletable(device, pTuio->prop_latency, FALSE);
+
+    if (pTuio->num_endpoints > 0) {
+        pTuio->prop_listen_stats = MakeAtom(TUIO_PROP_LISTEN_STATISTICS,
+                strlen(TUIO_PROP_LISTEN_STATISTICS), TRUE);
+        XIChangeDeviceProperty(device, pTuio->prop_listen_stats, XA_INTEGER,
+                               32, PropModeReplace,
+                               pTuio->num_endpoints * TUIO_LISTEN_STAT_COUNT,
+                               pTuio->endpoint_stats, FALSE);
+        XISetDevicePropertyDeletable(device, pTuio->prop_listen_stats,
+                                     FALSE);
+    }
+
+    pTuio->prop_calibration = MakeAtom(TUIO_PROP_CALIBRATION,
+                                       strlen(TUIO_PROP_CALIBRATION), TRUE);
+    XIChangeDeviceProperty(device, pTuio->prop_calibration,
+                           XIGetKnownProperty(XATOM_FLOAT), 32,
+                           PropModeReplace, 9, pTuio->calibration, FALSE);
+    XISetDevicePropertyDeletable(device, pTuio->prop_calibration, FALSE);
+
+    pTuio->prop_range = MakeAtom(TUIO_PROP_OUTPUT_RANGE,
+                                 strlen(TUIO_PROP_OUTPUT_RANGE), TRUE);
+    XIChangeDeviceProperty(device, pTuio->prop_range, XA_INTEGER, 32,
+                           PropModeReplace, 4, pTuio->output_range, FALSE);
+    XISetDevicePropertyDeletable(device, pTuio->prop_range, FALSE);
+
+    XIRegisterPropertyHandler(device, _set_property, _get_property, NULL);
+#endif
+}
+
+/**
+ * Free a TuioDeviceRec
+ */
+static void
+_free_tuiodev(TuioDevicePtr pTuio) {
+    ObjectPtr obj = pTuio->obj_list;
+    ObjectPtr tmp;
+    int i;
+
+    while (obj != NULL) {
+        tmp = obj->next;
+        xfree(obj);
+        obj = tmp;
+    }
+
+    if (pTuio->subdev_pipe[0] != -1) {
+        close(pTuio->subdev_pipe[0]);
+        close(pTuio->subdev_pipe[1]);
+    }
+
+    if (pTuio->flush_timer)
+        TimerFree(pTuio->flush_timer);
+    if (pTuio->resume_timer)
+        TimerFree(pTuio->resume_timer);
+    if (pTuio->watchdog_timer)
+        TimerFree(pTuio->watchdog_timer);
+    if (pTuio->drain_timer)
+        TimerFree(pTuio->drain_timer);
+    if (pTuio->park_timer)
+        TimerFree(pTuio->park_timer);
+
+    xfree(pTuio->recv_buf);
+    xfree(pTuio->backlog_stash);
+    xfree(pTuio->transport_path);
+    xfree(pTuio->mcast_group);
+    xfree(pTuio->mcast_iface);
+    for (i = 0; i < pTuio->num_endpoints; i++)
+        xfree(pTuio->endpoint_names[i]);
+    xfree(pTuio->grid);
+    _shm_close(pTuio);
+
+    xfree(pTuio->core_subdev);
+    xfree(pTuio);
+}
+
+/**
+ * Handles OSC messages in the /tuio/2Dcur address space
+ */
+static int
+_tuio_lo_2dcur_handle(const char *path,
+                      const char *types,
+                      lo_arg **argv,
+                      int argc,
+                      void *data,
+                      void *user_data) {
+    InputInfoPtr pInfo = user_data;
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr *obj_list = &pTuio->obj_list;
+    ObjectPtr obj, objtemp;
+    Bool created = False;
+    char *act;
+    int i;
+
+    if (argc == 0) {
+        xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d (argc == 0)\n", 
+                pInfo->name);
+        return 0;
+    } else if(*types != 's') {
+        xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d (types[0] != 's')\n", 
+                pInfo->name);
+        return 0;
+    }
+
+    /* Flag as being processed, used in TuioReadInput() */
+    pTuio->processed = 1;
+
+    /* Parse message type */
+    /* Set message type:  */
+    if (strcmp((char *)argv[0], "set") == 0) {
+
+        /* Simple type check */
+        if (strcmp(types, "sifffff")) {
+            xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d set msg (types == %s)\n", 
+                    pInfo->name, types);
+            return 0;
+        }
+
+        obj = _object_get(*obj_list, argv[1]->i);
+
+        /* If not found, create a new object */
+        if (obj == NULL) {
+            if (pTuio->num_sessions >= pTuio->max_sessions)
+                _object_evict(pInfo);
+            obj = _object_new(argv[1]->i);
+            _object_add(obj_list, obj);
+            pTuio->num_sessions++;
+            pTuio->stats[TUIO_STAT_ALLOCS]++;
+            created = True;
+        }
+        obj->seen = GetTimeInMillis();
+        obj->source = pTuio->source;
+        if (created)
+            _watchdog_add(pInfo, obj);
+
+        if (pTuio->grid)
+            _grid_move(pTuio, obj, argv[2]->f, argv[3]->f);
+
+        obj->pending.xpos = argv[2]->f;
+        obj->pending.ypos = argv[3]->f;
+        obj->pending.xvel = argv[4]->f;
+        obj->pending.yvel = argv[5]->f;
+        obj->pending.set = True;
+
+    } else if (strcmp((char *)argv[0], "alive") == 0) {
+        /* Simple type check */
+        for (i=1; i<argc; i++) {
+            if (types[i] != 'i') {
+                xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d alive msg "
+                        "(types == %s)\n", pInfo->name, types);
+                return 0;
+            }
+        }
+        _object_alive(pInfo, argv, argc);
+
+    } else if (strcmp((char *)argv[0], "fseq") == 0) {
+        /* Simple type check */
+        if (strcmp(types, "si")) {
+            xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d fseq msg (types == %s)\n", 
+                    pInfo->name, types);
+            return 0;
+        }
+        pTuio->fseq_new = argv[1]->i;
+
+    }
+    return 0;
+}
+
+/**
+ * liblo error handler
+ */
+static void
+_lo_error(int num,
+         const char *msg,
+         const char *path)
+{
+    xf86Msg(X_ERROR, "liblo: %s\n", msg);
+}
+
+/**
+ * Monotonic time in microseconds, used for the timing statistics.
+ * Wraps around after ~71 minutes, only use it for differences.
+ */
+static CARD32
+_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Counts a frame latency in the log-linear histogram described in
+ * tuio-properties.h
+ */
+static void
+_latency_add(TuioDevicePtr pTuio, CARD32 us)
+{
+    int bucket, e = 0;
+
+    if (us < 4) {
+        bucket = us;
+    } else {
+        while ((us >> e) > 1)
+            e++;
+        bucket = 4 * (e - 1) + ((us >> (e - 2)) & 3);
+        if (bucket >= TUIO_LATENCY_BUCKETS)
+            bucket = TUIO_LATENCY_BUCKETS - 1;
+    }
+    pTuio->latency[bucket]++;
+}
+
+/* Fixed point scale of positions and transform coefficients */
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+/**
+ * Checks whether a calibration matrix and an output range can be used
+ */
+static Bool
+_transform_check(const float *matrix, const int *range)
+{
+    if (range[0] < 0 || range[1] < 0 || range[2] < 0 || range[3] < 0)
+        return False;
+
+    /* Affine matrices are scaled by the last element */
+    if (matrix[6] == 0 && matrix[7] == 0 && matrix[8] == 0)
+        return False;
+
+    return True;
+}
+
+/**
+ * Folds a calibration matrix and an output range into the transform
+ * applied to every position.  Returns False if the matrix can't be used.
+ */
+static Bool
+_transform_update(TuioDevicePtr pTuio, const float *matrix, const int *range)
+{
+    double m[9], xr, yr;
+    int i;
+
+    if (!_transform_check(matrix, range))
+        return False;
+
+    for (i = 0; i < 9; i++)
+        m[i] = matrix[i];
+
+    /* An affine matrix is scaled so its last row is (0, 0, 1) */
+    if (m[6] == 0 && m[7] == 0) {
+        for (i = 0; i < 9; i++)
+            m[i] /= matrix[8];
+    }
+
+    memmove(pTuio->calibration, matrix, sizeof(pTuio->calibration));
+    memmove(pTuio->output_range, range, sizeof(pTuio->output_range));
+
+    xr = (double)range[1] - range[0];
+    yr = (double)range[3] - range[2];
+
+    pTuio->transform.projective = m[6] != 0 || m[7] != 0;
+    if (!pTuio->transform.projective) {
+        pTuio->transform.x[0] = llrint(xr * m[0]);
+        pTuio->transform.x[1] = llrint(xr * m[1]);
+        pTuio->transform.x[2] = llrint((range[0] + xr * m[2]) * FIXED_ONE);
+        pTuio->transform.y[0] = llrint(yr * m[3]);
+        pTuio->transform.y[1] = llrint(yr * m[4]);
+        pTuio->transform.y[2] = llrint((range[2] + yr * m[5]) * FIXED_ONE);
+    }
+
+    /* Velocities keep their scale of 0x7FFFFFFF per surface per second */
+    pTuio->transform.vx[0] = llrint(0x7FFFFFFF * m[0]);
+    pTuio->transform.vx[1] = llrint(0x7FFFFFFF * m[1]);
+    pTuio->transform.vy[0] = llrint(0x7FFFFFFF * m[3]);
+    pTuio->transform.vy[1] = llrint(0x7FFFFFFF * m[4]);
+
+    return True;
+}
+
+/* Clamps a 64 bit value to a valuator */
+#define CLAMP_VALUATOR(v) \
+    ((int)((v) > 0x7FFFFFFF ? 0x7FFFFFFF : (v) < -0x7FFFFFFF ? -0x7FFFFFFF : (v)))
+
+/* Converts a TUIO coordinate to fixed point, well outside 0 to 1 is junk */
+#define TO_FIXED(f) ((int64_t)(max(-16.0f, min((f), 16.0f)) * FIXED_ONE))
+
+/**
+ * Maps the pending position and velocity of an object to valuators
+ */
+static void
+_transform_apply(TuioDevicePtr pTuio, ObjectPtr obj)
+{
+    int64_t x, y, vx, vy;
+    float *m, w;
+    int *range;
+
+    vx = TO_FIXED(obj->pending.xvel);
+    vy = TO_FIXED(obj->pending.yvel);
+
+    if (!pTuio->transform.projective) {
+        x = TO_FIXED(obj->pending.xpos);
+        y = TO_FIXED(obj->pending.ypos);
+        obj->pending.valuators[0] = CLAMP_VALUATOR(
+                (pTuio->transform.x[0] * x + pTuio->transform.x[1] * y +
+                 pTuio->transform.x[2]) >> FIXED_SHIFT);
+        obj->pending.valuators[1] = CLAMP_VALUATOR(
+                (pTuio->transform.y[0] * x + pTuio->transform.y[1] * y +
+                 pTuio->transform.y[2]) >> FIXED_SHIFT);
+    } else {
+        /* Perspective needs a division per touch, do it in floating point */
+        m = pTuio->calibration;
+        range = pTuio->output_range;
+        w = m[6] * obj->pending.xpos + m[7] * obj->pending.ypos + m[8];
+        if (w == 0)
+            w = 1e-6;
+        obj->pending.valuators[0] = CLAMP_VALUATOR((int64_t)(range[0] +
+                ((double)range[1] - range[0]) * (m[0] * obj->pending.xpos +
+                 m[1] * obj->pending.ypos + m[2]) / w));
+        obj->pending.valuators[1] = CLAMP_VALUATOR((int64_t)(range[2] +
+                ((double)range[3] - range[2]) * (m[3] * obj->pending.xpos +
+                 m[4] * obj->pending.ypos + m[5]) / w));
+    }
+
+    obj->pending.valuators[2] = CLAMP_VALUATOR(
+            (pTuio->transform.vx[0] * vx + pTuio->transform.vx[1] * vy) >>
+            FIXED_SHIFT);
+    obj->pending.valuators[3] = CLAMP_VALUATOR(
+            (pTuio->transform.vy[0] * vx + pTuio->transform.vy[1] * vy) >>
+            FIXED_SHIFT);
+}
+
+/**
+ * Creates the shared memory object committed frames are published in.
+ * It is world readable, only the server writes to it.  A leftover object
+ * of the same name is unlinked first, and the new one is created
+ * exclusively, so nobody else can have it open for writing.
+ */
+static void
+_shm_open(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    TuioShmHeader *shm;
+    char *path;
+    int fd;
+
+    asprintf(&path, TUIO_SHM_PREFIX "%s", pTuio->shm_name);
+    shm_unlink(path);
+    fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        xf86Msg(X_WARNING, "%s: Unable to create shared memory %s\n",
+                pInfo->name, path);
+        free(path);
+        return;
+    }
+
+    /* The mode given to shm_open() is subject to the umask */
+    if (fchmod(fd, 0644) == -1 ||
+        ftruncate(fd, sizeof(TuioShmHeader)) == -1 ||
+        (shm = mmap(NULL, sizeof(TuioShmHeader), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        xf86Msg(X_WARNING, "%s: Unable to map shared memory %s\n",
+                pInfo->name, path);
+        shm_unlink(path);
+        close(fd);
+        free(path);
+        return;
+    }
+    close(fd);
+
+    shm->magic = TUIO_SHM_MAGIC;
+    shm->version = TUIO_SHM_VERSION;
+    shm->slots = TUIO_SHM_SLOTS;
+    shm->max_objects = TUIO_SHM_MAX_OBJECTS;
+    pTuio->shm = shm;
+
+    xf86Msg(X_INFO, "%s: Publishing frames in shared memory %s\n",
+            pInfo->name, path);
+    free(path);
+}
+
+/**
+ * Publishes the objects of the frame just committed in the next slot of
+ * the shared memory ring.  Rejected objects are left out.
+ */
+static void
+_shm_publish(TuioDevicePtr pTuio)
+{
+    TuioShmHeader *shm = pTuio->shm;
+    TuioShmFrame *frame;
+    TuioShmObject *out;
+    ObjectPtr obj;
+    struct timespec now;
+    uint32_t n = 0;
+
+    frame = &shm->frames[shm->head % TUIO_SHM_SLOTS];
+
+    /* Odd while writing, readers retry when they see it change */
+    frame->seq++;
+    __sync_synchronize();
+
+    for (obj = pTuio->obj_list;
+         obj != NULL && n < TUIO_SHM_MAX_OBJECTS; obj = obj->next) {
+        if (obj->rejected)
+            continue;
+        out = &frame->objects[n++];
+        out->id = obj->id;
+        out->x = obj->pending.xpos;
+        out->y = obj->pending.ypos;
+        out->xvel = obj->pending.xvel;
+        out->yvel = obj->pending.yvel;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    frame->fseq = pTuio->fseq_new;
+    frame->frame = shm->head + 1;
+    frame->num_objects = n;
+    frame->time_us = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+    __sync_synchronize();
+    frame->seq++;
+    __sync_synchronize();
+    shm->head++;
+}
+
+/**
+ * Removes the shared memory object
+ */
+static void
+_shm_close(TuioDevicePtr pTuio)
+{
+    char *path;
+
+    if (pTuio->shm) {
+        munmap(pTuio->shm, sizeof(TuioShmHeader));
+        asprintf(&path, TUIO_SHM_PREFIX "%s", pTuio->shm_name);
+        shm_unlink(path);
+        free(path);
+        pTuio->shm = NULL;
+    }
+    xfree(pTuio->shm_name);
+}
+
+/**
+ * Adds a dead zone, given in normalised coordinates
+ */
+static void
+_dead_zone_add(TuioDevicePtr pTuio, float x0, float y0, float x1, float y1)
+{
+    DeadZoneRec *zone;
+
+    if (pTuio->num_dead_zones == MAX_DEAD_ZONES)
+        return;
+
+    zone = &pTuio->dead_zones[pTuio->num_dead_zones++];
+    zone->x0 = min(x0, x1);
+    zone->y0 = min(y0, y1);
+    zone->x1 = max(x0, x1);
+    zone->y1 = max(y0, y1);
+}
+
+/**
+ * Sets up the region filter grid from the DeadZones and DeadBorder
+ * options.  Zones are given as space separated "x0,y0,x1,y1" rectangles.
+ * Cells completely inside a dead zone, and cells that are not touched by
+ * one, are marked once here, so most touches don't check the zones.
+ */
+static void
+_grid_init(InputInfoPtr pInfo, const char *name, char *zones, float border)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    DeadZoneRec *zone;
+    float x0, y0, x1, y1, size;
+    char *tok, *save;
+    int i, j, z;
+
+    if (zones != NULL) {
+        for (tok = strtok_r(zones, " ", &save); tok != NULL;
+             tok = strtok_r(NULL, " ", &save)) {
+            if (sscanf(tok, "%f,%f,%f,%f", &x0, &y0, &x1, &y1) != 4) {
+                xf86Msg(X_WARNING, "%s: Invalid dead zone %s\n", name, tok);
+                continue;
+            }
+            _dead_zone_add(pTuio, x0, y0, x1, y1);
+        }
+    }
+
+    if (border > 0) {
+        _dead_zone_add(pTuio, 0, 0, 1, border);
+        _dead_zone_add(pTuio, 0, 1 - border, 1, 1);
+        _dead_zone_add(pTuio, 0, 0, border, 1);
+        _dead_zone_add(pTuio, 1 - border, 0, 1, 1);
+    }
+
+    if (pTuio->num_dead_zones == 0 && pTuio->palm_contacts == 0)
+        return;
+
+    xf86Msg(X_INFO, "%s: Region filter with %i dead zones, %ix%i cells\n",
+            name, pTuio->num_dead_zones, pTuio->grid_size, pTuio->grid_size);
+
+    pTuio->grid = xcalloc(pTuio->grid_size * pTuio->grid_size,
+                          sizeof(GridCellRec));
+    size = 1.0 / pTuio->grid_size;
+
+    for (j = 0; j < pTuio->grid_size; j++) {
+        for (i = 0; i < pTuio->grid_size; i++) {
+            GridCellPtr cell = &pTuio->grid[j * pTuio->grid_size + i];
+
+            x0 = i * size;
+            y0 = j * size;
+            x1 = x0 + size;
+            y1 = y0 + size;
+
+            for (z = 0; z < pTuio->num_dead_zones; z++) {
+                zone = &pTuio->dead_zones[z];
+                if (zone->x0 <= x0 && zone->y0 <= y0 &&
+                    zone->x1 >= x1 && zone->y1 >= y1) {
+                    cell->zone = CELL_DEAD;
+                    break;
+                }
+                if (zone->x0 < x1 && zone->x1 > x0 &&
+                    zone->y0 < y1 && zone->y1 > y0)
+                    cell->zone = CELL_PARTIAL;
+            }
+        }
+    }
+}
+
+/**
+ * Moves an object to the grid cell of a new position
+ */
+static void
+_grid_move(TuioDevicePtr pTuio, ObjectPtr obj, float x, float y)
+{
+    int i, j, cell;
+
+    i = x * pTuio->grid_size;
+    j = y * pTuio->grid_size;
+    i = max(0, min(i, pTuio->grid_size - 1));
+    j = max(0, min(j, pTuio->grid_size - 1));
+    cell = j * pTuio->grid_size + i;
+
+    if (cell == obj->cell)
+        return;
+
+    if (obj->cell >= 0)
+        pTuio->grid[obj->cell].count--;
+    pTuio->grid[cell].count++;
+    obj->cell = cell;
+}
+
+/**
+ * Checks whether a new object came down in a dead zone, or together with
+ * so many other objects in its cell that it is a palm
+ */
+static Bool
+_grid_reject(TuioDevicePtr pTuio, ObjectPtr obj)
+{
+    GridCellPtr cell;
+    DeadZoneRec *zone;
+    int z;
+
+    if (obj->cell < 0)
+        return False;
+    cell = &pTuio->grid[obj->cell];
+
+    if (pTuio->palm_contacts > 0 && cell->count >= pTuio->palm_contacts)
+        return True;
+
+    if (cell->zone == CELL_DEAD)
+        return True;
+
+    if (cell->zone == CELL_PARTIAL) {
+        for (z = 0; z < pTuio->num_dead_zones; z++) {
+            zone = &pTuio->dead_zones[z];
+            if (obj->pending.xpos >= zone->x0 &&
+                obj->pending.xpos < zone->x1 &&
+                obj->pending.ypos >= zone->y0 &&
+                obj->pending.ypos < zone->y1)
+                return True;
+        }
+    }
+
+    return False;
+}
+
+/**
+ * Retrieves an object from a list based on its id.
+ *
+ * @return NULL if not found.
+ */
+static ObjectPtr
+_object_get(ObjectPtr head, int id) {
+    ObjectPtr obj = head;
+
+    while (obj != NULL && obj->id != id) {
+        obj = obj->next;
+    }
+
+    return obj;
+}
+
+/**
+ * Allocates and inserts a new object at the beginning of a list.
+ * Pointer to the new object is returned.
+ * Doesn't check for duplicate ids, so call _object_get() beforehand
+ * to make sure it doesn't exist already!!
+ *
+ * @return ptr to newly inserted object
+ */
+static ObjectPtr 
+_object_new(int id) {
+    ObjectPtr new_obj = xcalloc(1, sizeof(ObjectRec));
+
+    new_obj->id = id;
+    new_obj->fresh = True;
+    new_obj->cell = -1;
+
+    return new_obj;
+}
+
+/**
+ * Adds a SubDevice to the beginning of the subdev_list list
+ */
+static void
+_object_add(ObjectPtr *obj_list, ObjectPtr obj) {
+
+    if (obj_list == NULL || obj == NULL)
+        return;
+
+    if (*obj_list != NULL) {
+        obj->next = *obj_list;
+    }
+    *obj_list = obj;
+}
+
+
+/**
+ * Removes an Object with a specific id from a list.
+ */
+static ObjectPtr
+_object_remove(ObjectPtr *obj_list, int id) {
+    ObjectPtr obj = *obj_list;
+    ObjectPtr objtmp;
+
+    if (obj == NULL) return; /* Empty list */
+
+    if (obj->id == id) { /* Remove from head */
+        *obj_list = obj->next;
+    } else {
+        while (obj->next != NULL) {
+            if (obj->next->id == id) {
+                objtmp = obj->next;
+                obj->next = objtmp->next;
+                obj = objtmp;
+                obj->next = NULL;
+                return obj;    
+            }
+            obj = obj->next;
+        }
+        obj = NULL;
+    }
+
+    return obj;
+}
+
+/**
+ * Releases every object of the sending source whose session id is
+ * missing from an alive message right away, so a lifted touch doesn't
+ * wait for the fseq of its frame (or stick if that never arrives).  The
+ * objects listed are marked, then the unmarked ones of the source are
+ * released in one pass over the list; touches of other trackers are left
+ * alone.  Alive messages of stale frames don't get here, see
+ * _bundle_stale().
+ */
+static void
+_object_alive(InputInfoPtr pInfo, lo_arg **argv, int argc) {
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr *prev = &pTuio->obj_list;
+    ObjectPtr obj;
+    CARD32 now = GetTimeInMillis();
+    int i;
+
+    for (i=1; i<argc; i++) {
+        obj = _object_get(pTuio->obj_list, argv[i]->i);
+        if (obj) {
+            obj->alive = True;
+            obj->seen = now;
+            obj->source = pTuio->source;
+        }
+    }
+
+    while ((obj = *prev) != NULL) {
+        if (obj->alive || obj->source != pTuio->source) {
+            obj->alive = False;
+            prev = &obj->next;
+        } else {
+            *prev = obj->next;
+            obj->next = NULL;
+            _object_release(pInfo, obj);
+        }
+    }
+}
+
+/**
+ * Releases a session to make room for a new one once MaxSessions are
+ * tracked, so a tracker minting session ids without alive messages
+ * can't grow the object list: the least recently updated one, or with
+ * EvictionPolicy "oldest" the first one seen, which is at the end of the
+ * list.
+ */
+static void
+_object_evict(InputInfoPtr pInfo) {
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr *prev, *victim = NULL;
+    ObjectPtr obj;
+
+    /* Ties go to the older session */
+    for (prev = &pTuio->obj_list; *prev != NULL; prev = &(*prev)->next) {
+        if (pTuio->eviction_policy == EVICT_OLDEST || victim == NULL ||
+            (int)((*prev)->seen - (*victim)->seen) <= 0)
+            victim = prev;
+    }
+    if (victim == NULL)
+        return;
+    obj = *victim;
+
+    if (!pTuio->evict_logged) {
+        xf86Msg(X_WARNING, "%s: MaxSessions (%i) reached, evicting "
+                "session %i\n", pInfo->name, pTuio->max_sessions, obj->id);
+        pTuio->evict_logged = True;
+    }
+    pTuio->stats[TUIO_STAT_EVICTIONS]++;
+
+    *victim = obj->next;
+    obj->next = NULL;
+    _object_release(pInfo, obj);
+}
+
+/**
+ * Posts the current position of an object as a motion event on its
+ * subdevice
+ */
+static void
+_object_motion(TuioDevicePtr pTuio, ObjectPtr obj) {
+    /* TODO: Add more valuators with additional information */
+    xf86PostMotionEventP(obj->subdev->pInfo->dev,
+            TRUE, /* is_absolute */
+            0, /* first_valuator */
+            NUM_VALUATORS, /* num_valuators */
+            obj->valuators);
+    pTuio->stats[TUIO_STAT_EVENTS]++;
+    obj->dirty = False;
+}
+
+/**
+ * Returns whether events can be posted on the subdevice of an object.
+ * Subdevices may be turned off before their core device, so a device
+ * that is off is skipped like a parked one.
+ */
+static Bool
+_object_postable(ObjectPtr obj)
+{
+    return obj->subdev && !obj->subdev->parked &&
+           obj->subdev->pInfo->dev->public.on;
+}
+
+/**
+ * Posts the pending state of an object on its subdevice.  Objects
+ * without a usable subdevice keep their pending state until they get one.
+ * With a frame rate limit, motion is only recorded here and posted by
+ * _flush_timer(); button presses are always posted right away.
+ */
+static void
+_object_post(TuioDevicePtr pTuio, ObjectPtr obj) {
+    if (!obj->pending.set || !_object_postable(obj))
+        return;
+
+    obj->xpos = obj->pending.xpos;
+    obj->ypos = obj->pending.ypos;
+    obj->xvel = obj->pending.xvel;
+    obj->yvel = obj->pending.yvel;
+    memcpy(obj->valuators, obj->pending.valuators, sizeof(obj->valuators));
+    obj->pending.set = False;
+
+    if (!obj->pending.button) {
+        /* Touches taking part in a gesture are only posted as the
+         * gesture, and stale frames don't post motion at all */
+        if (pTuio->gesture.active || pTuio->drop_motion)
+            return;
+
+        if (pTuio->max_frame_rate > 0) {
+            obj->dirty = True; /* See _flush_schedule() */
+            return;
+        }
+    }
+
+    _object_motion(pTuio, obj);
+
+    if (obj->pending.button) {
+        xf86PostButtonEvent(obj->subdev->pInfo->dev, TRUE, 1, TRUE, 0, 0);
+        pTuio->stats[TUIO_STAT_EVENTS]++;
+        obj->pending.button = False;
+    }
+}
+
+/**
+ * Posts the motion held back by MaxFrameRate now if it is due, or arms
+ * the flush timer for when it is.  The timer only runs while motion is
+ * held back.
+ */
+static void
+_flush_schedule(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    int32_t wait;
+
+    if (pTuio->flush_armed)
+        return;
+
+    wait = (int32_t)(pTuio->flush_due - _time_us());
+    if (wait <= 0) {
+        _flush(pInfo);
+        return;
+    }
+
+    pTuio->flush_armed = True;
+    pTuio->flush_timer = TimerSet(pTuio->flush_timer, 0, (wait + 999) / 1000,
+                                  _flush_timer, pInfo);
+}
+
+/**
+ * Posts the latest position of every object that moved since the last
+ * flush.  Flushes are due every 1000000 / MaxFrameRate us, counted from
+ * the previous due time rather than from when the timer fired, so the
+ * millisecond timer doesn't slow the rate down (or up: 120 Hz would be
+ * 125 Hz with a whole millisecond period).
+ */
+static void
+_flush(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr obj;
+    CARD32 events, now, period;
+
+    events = pTuio->stats[TUIO_STAT_EVENTS];
+    for (obj = pTuio->obj_list; obj != NULL; obj = obj->next) {
+        if (obj->dirty && _object_postable(obj) && !pTuio->gesture.active)
+            _object_motion(pTuio, obj);
+    }
+    if (pTuio->stats[TUIO_STAT_EVENTS] != events)
+        pTuio->stats[TUIO_STAT_OUTPUT_FRAMES]++;
+
+    /* After an idle period the schedule starts over */
+    now = _time_us();
+    period = 1000000 / pTuio->max_frame_rate;
+    if (now - pTuio->flush_due < period)
+        pTuio->flush_due += period;
+    else
+        pTuio->flush_due = now + period;
+}
+
+/**
+ * Timer callback that posts the motion held back by MaxFrameRate
+ *
+ * @return 0, the timer is armed again once more motion is held back
+ */
+static CARD32
+_flush_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    InputInfoPtr pInfo = arg;
+    TuioDevicePtr pTuio = pInfo->private;
+    int sigstate;
+
+    sigstate = xf86BlockSIGIO();
+    pTuio->flush_armed = False;
+    _flush(pInfo);
+    xf86UnblockSIGIO(sigstate);
+
+    return 0;
 }
 
 /**
- * Free a TuioDeviceRec
+ * Releases an object that has already been taken out of the object
+ * list, and returns its subdevice to the pool.
  */
 static void
-_free_tuiodev(TuioDevicePtr pTuio) {
-    ObjectPtr obj = pTuio->obj_list;
-    ObjectPtr tmp;
+_object_release(InputInfoPtr pInfo, ObjectPtr obj) {
+    TuioDevicePtr pTuio = pInfo->private;
 
-    while (obj != NULL) {
-        tmp = obj->next;
-        xfree(obj);
-        obj = tmp;
+    /* Post motion held back by the frame rate limit, so the touch is
+     * released where it was lifted */
+    if (obj->dirty && _object_postable(obj))
+        _object_motion(pTuio, obj);
+
+    /* Post button "up" event, unless the button never went down */
+    if (_object_postable(obj) && !obj->pending.button &&
+        pTuio->post_button_events) {
+        xf86PostButtonEvent(obj->subdev->pInfo->dev, TRUE, 1, FALSE, 0, 0);
+        pTuio->stats[TUIO_STAT_EVENTS]++;
     }
 
-    xfree(pTuio);
+    if (obj->cell >= 0)
+        pTuio->grid[obj->cell].count--;
+    _watchdog_remove(obj);
+    _subdev_add(pInfo, obj->subdev);
+    pTuio->num_sessions--;
+    xfree(obj);
 }
 
 /**
- * Handles OSC messages in the /tuio/2Dcur address space
+ * Starts the watchdog timer if a timeout is set and it isn't running
  */
-static int
-_tuio_lo_2dcur_handle(const char *path,
-                      const char *types,
-                      lo_arg **argv,
-                      int argc,
-                      void *data,
-                      void *user_data) {
-    InputInfoPtr pInfo = user_data;
+static void
+_watchdog_arm(InputInfoPtr pInfo)
+{
     TuioDevicePtr pTuio = pInfo->private;
-    ObjectPtr *obj_list = &pTuio->obj_list;
-    ObjectPtr obj, objtemp;
-    char *act;
-    int i;
 
-    if (argc == 0) {
-        xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d (argc == 0)\n", 
-                pInfo->name);
-        return 0;
-    } else if(*types != 's') {
-        xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d (types[0] != 's')\n", 
-                pInfo->name);
-        return 0;
-    }
+    if (pTuio->watchdog_armed ||
+        (pTuio->session_timeout == 0 && pTuio->source_timeout == 0))
+        return;
 
-    /* Flag as being processed, used in TuioReadInput() */
-    pTuio->processed = 1;
+    pTuio->wheel_time = GetTimeInMillis();
+    pTuio->watchdog_timer = TimerSet(pTuio->watchdog_timer, 0,
+                                     pTuio->watchdog_tick,
+                                     _watchdog_timer, pInfo);
+    pTuio->watchdog_armed = True;
+}
 
-    /* Parse message type */
-    /* Set message type:  */
-    if (strcmp((char *)argv[0], "set") == 0) {
+/**
+ * Puts an object in the wheel slot of the time its session expires, or
+ * of the next slot if that has passed already
+ */
+static void
+_watchdog_add(InputInfoPtr pInfo, ObjectPtr obj)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr *slot;
+    CARD32 when;
 
-        /* Simple type check */
-        if (strcmp(types, "sifffff")) {
-            xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d set msg (types == %s)\n", 
-                    pInfo->name, types);
-            return 0;
-        }
+    _watchdog_arm(pInfo);
+    if (pTuio->session_timeout == 0)
+        return;
 
-        obj = _object_get(*obj_list, argv[1]->i);
+    when = obj->seen + pTuio->session_timeout;
+    if ((int)(when - pTuio->wheel_time) < 0)
+        when = pTuio->wheel_time;
+    slot = &pTuio->wheel[(when / pTuio->watchdog_tick) & (WHEEL_SLOTS - 1)];
 
-        /* If not found, create a new object */
-        if (obj == NULL) {
-            obj = _object_new(argv[1]->i);
-            _object_add(obj_list, obj);
-            obj->subdev = _subdev_get(pInfo, &pTuio->subdev_list);
-            if (obj->subdev && pTuio->post_button_events)
-                obj->pending.button = True;
-        }
+    obj->wheel_next = *slot;
+    if (*slot)
+        (*slot)->wheel_prev = &obj->wheel_next;
+    obj->wheel_prev = slot;
+    *slot = obj;
+}
 
-        obj->pending.xpos = argv[2]->f;
-        obj->pending.ypos = argv[3]->f;
-        obj->pending.xvel = argv[4]->f;
-        obj->pending.yvel = argv[5]->f;
-        obj->pending.set = True;
+/**
+ * Takes an object out of the watchdog wheel
+ */
+static void
+_watchdog_remove(ObjectPtr obj)
+{
+    if (!obj->wheel_prev)
+        return;
 
-    } else if (strcmp((char *)argv[0], "alive") == 0) {
-        /* Mark all objects that are still alive */
-        obj = *obj_list;
-        while (obj != NULL) {
-            for (i=1; i<argc; i++) {
-                if (argv[i]->i == obj->id) {
-                    obj->alive = True;
-                    break;
-                }
-            }
-            obj = obj->next;
-        }
+    *obj->wheel_prev = obj->wheel_next;
+    if (obj->wheel_next)
+        obj->wheel_next->wheel_prev = obj->wheel_prev;
+    obj->wheel_next = NULL;
+    obj->wheel_prev = NULL;
+}
 
-    } else if (strcmp((char *)argv[0], "fseq") == 0) {
-        /* Simple type check */
-        if (strcmp(types, "si")) {
-            xf86Msg(X_ERROR, "%s: Error in /tuio/cur2d fseq msg (types == %s)\n", 
-                    pInfo->name, types);
-            return 0;
+/**
+ * Releases the touches last updated by a source
+ *
+ * @return the number of touches released
+ */
+static int
+_source_release(InputInfoPtr pInfo, SourcePtr src)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr *prev = &pTuio->obj_list;
+    ObjectPtr obj;
+    int n = 0;
+
+    while ((obj = *prev) != NULL) {
+        if (obj->source == src) {
+            *prev = obj->next;
+            obj->next = NULL;
+            _object_release(pInfo, obj);
+            n++;
+        } else {
+            prev = &obj->next;
         }
-        pTuio->fseq_new = argv[1]->i;
-
     }
-    return 0;
+
+    return n;
 }
 
 /**
- * liblo error handler
+ * Releases the touches of a source that has been silent for SourceTimeout
  */
 static void
-_lo_error(int num,
-         const char *msg,
-         const char *path)
+_source_timeout(InputInfoPtr pInfo, SourcePtr src, CARD32 now)
 {
-    xf86Msg(X_ERROR, "liblo: %s\n", msg);
+    TuioDevicePtr pTuio = pInfo->private;
+    int n;
+
+    if (src->type == SOURCE_LISTEN || src->timed_out ||
+        (int)(now - src->seen) < pTuio->source_timeout)
+        return;
+
+    src->timed_out = True;
+    n = _source_release(pInfo, src);
+    if (n > 0) {
+        pTuio->stats[TUIO_STAT_TIMEOUTS]++;
+        xf86Msg(X_WARNING, "%s: Tracker silent for %i ms, released "
+                "%i touches\n", pInfo->name, pTuio->source_timeout, n);
+    }
 }
 
 /**
- * Retrieves an object from a list based on its id.
+ * Watchdog tick.  Releases the touches of sources that have been silent
+ * for SourceTimeout, and expires the wheel slots that have passed: their
+ * objects are released if they haven't been seen for SessionTimeout, or
+ * put back in the slot of their new expiry time.  Stops itself once there
+ * are no objects left.
  *
- * @return NULL if not found.
+ * @return the interval until the next tick
  */
-static ObjectPtr
-_object_get(ObjectPtr head, int id) {
-    ObjectPtr obj = head;
+static CARD32
+_watchdog_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    InputInfoPtr pInfo = arg;
+    TuioDevicePtr pTuio = pInfo->private;
+    SourcePtr src, sender;
+    ObjectPtr obj, next;
+    int sigstate, n, expired = 0;
 
-    while (obj != NULL && obj->id != id) {
-        obj = obj->next;
+    sigstate = xf86BlockSIGIO();
+
+    if (pTuio->source_timeout > 0) {
+        for (src = pTuio->sources; src != NULL; src = src->next) {
+            _source_timeout(pInfo, src, now);
+            for (sender = src->senders; sender != NULL; sender = sender->next)
+                _source_timeout(pInfo, sender, now);
+        }
     }
 
-    return obj;
-}
+    /* After a long delay every slot is due, but only once */
+    if ((int)(now - pTuio->wheel_time) >=
+        WHEEL_SLOTS * pTuio->watchdog_tick)
+        pTuio->wheel_time = now - (WHEEL_SLOTS - 1) * pTuio->watchdog_tick;
+
+    while ((int)(now - pTuio->wheel_time) >= 0) {
+        n = (pTuio->wheel_time / pTuio->watchdog_tick) & (WHEEL_SLOTS - 1);
+        obj = pTuio->wheel[n];
+        pTuio->wheel[n] = NULL;
+        pTuio->wheel_time += pTuio->watchdog_tick;
+
+        for (; obj != NULL; obj = next) {
+            next = obj->wheel_next;
+            obj->wheel_prev = NULL;
+            obj->wheel_next = NULL;
+
+            if ((int)(now - obj->seen) < pTuio->session_timeout) {
+                _watchdog_add(pInfo, obj);
+            } else {
+                obj = _object_remove(&pTuio->obj_list, obj->id);
+                _object_release(pInfo, obj);
+                expired++;
+            }
+        }
+    }
 
-/**
- * Allocates and inserts a new object at the beginning of a list.
- * Pointer to the new object is returned.
- * Doesn't check for duplicate ids, so call _object_get() beforehand
- * to make sure it doesn't exist already!!
- *
- * @return ptr to newly inserted object
- */
-static ObjectPtr 
-_object_new(int id) {
-    ObjectPtr new_obj = xcalloc(1, sizeof(ObjectRec));
+    if (expired > 0) {
+        pTuio->stats[TUIO_STAT_TIMEOUTS] += expired;
+        xf86Msg(X_WARNING, "%s: %i touches not updated for %i ms, "
+                "released\n", pInfo->name, expired, pTuio->session_timeout);
+    }
 
-    new_obj->id = id;
-    new_obj->alive = True;
+    if (!pTuio->obj_list)
+        pTuio->watchdog_armed = False;
 
-    return new_obj;
+    xf86UnblockSIGIO(sigstate);
+
+    return pTuio->watchdog_armed ? pTuio->watchdog_tick : 0;
 }
 
 /**
- * Adds a SubDevice to the beginning of the subdev_list list
+ * Posts a scroll button click on the core device
  */
 static void
-_object_add(ObjectPtr *obj_list, ObjectPtr obj) {
-
-    if (obj_list == NULL || obj == NULL)
-        return;
+_gesture_click(InputInfoPtr pInfo, int button)
+{
+    TuioDevicePtr pTuio = pInfo->private;
 
-    if (*obj_list != NULL) {
-        obj->next = *obj_list;
-    }
-    *obj_list = obj;
+    xf86PostButtonEvent(pInfo->dev, TRUE, button, TRUE, 0, 0);
+    xf86PostButtonEvent(pInfo->dev, TRUE, button, FALSE, 0, 0);
+    pTuio->stats[TUIO_STAT_EVENTS] += 2;
 }
 
-
 /**
- * Removes an Object with a specific id from a list.
+ * Incremental two finger gesture recognizer, run for each committed
+ * frame before its touches are posted.  The centroid and spread of the touches are computed in one pass
+ * over the object list.  While exactly two touches stay down, centroid
+ * movement is posted as scroll button clicks (4/5 vertical, 6/7
+ * horizontal) and the change in spread as a zoom factor, both on the core
+ * device.
+ *
+ * The positions are the latest ones from the tracker, not the posted ones:
+ * a touch on a parked subdevice, or one without a subdevice, has not been
+ * posted yet.
  */
-static ObjectPtr
-_object_remove(ObjectPtr *obj_list, int id) {
-    ObjectPtr obj = *obj_list;
-    ObjectPtr objtmp;
+static void
+_gesture_update(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ObjectPtr obj;
+    float sx = 0, sy = 0, sxx = 0, syy = 0;
+    float cx, cy, spread;
+    int n = 0, zoom;
+
+    for (obj = pTuio->obj_list; obj != NULL; obj = obj->next) {
+        if (obj->rejected)
+            continue;
+        sx += obj->pending.xpos;
+        sy += obj->pending.ypos;
+        sxx += obj->pending.xpos * obj->pending.xpos;
+        syy += obj->pending.ypos * obj->pending.ypos;
+        n++;
+    }
 
-    if (obj == NULL) return; /* Empty list */
+    if (n != 2) {
+        pTuio->gesture.active = False;
+        pTuio->gesture.touches = n;
+        return;
+    }
 
-    if (obj->id == id) { /* Remove from head */
-        *obj_list = obj->next;
+    cx = sx / n;
+    cy = sy / n;
+    spread = sqrtf(fmaxf(sxx / n - cx * cx + syy / n - cy * cy, 0));
+
+    if (pTuio->gesture.touches != 2) {
+        /* Gesture starts */
+        pTuio->gesture.active = True;
+        pTuio->gesture.touches = n;
+        pTuio->gesture.scroll_x = 0;
+        pTuio->gesture.scroll_y = 0;
+        pTuio->gesture.zoom = 1.0;
     } else {
-        while (obj->next != NULL) {
-            if (obj->next->id == id) {
-                objtmp = obj->next;
-                obj->next = objtmp->next;
-                obj = objtmp;
-                obj->next = NULL;
-                return obj;    
-            }
-            obj = obj->next;
+        pTuio->gesture.scroll_x += cx - pTuio->gesture.cx;
+        pTuio->gesture.scroll_y += cy - pTuio->gesture.cy;
+
+        while (pTuio->gesture.scroll_y <= -pTuio->scroll_distance) {
+            _gesture_click(pInfo, 4);
+            pTuio->gesture.scroll_y += pTuio->scroll_distance;
+        }
+        while (pTuio->gesture.scroll_y >= pTuio->scroll_distance) {
+            _gesture_click(pInfo, 5);
+            pTuio->gesture.scroll_y -= pTuio->scroll_distance;
+        }
+        while (pTuio->gesture.scroll_x <= -pTuio->scroll_distance) {
+            _gesture_click(pInfo, 6);
+            pTuio->gesture.scroll_x += pTuio->scroll_distance;
+        }
+        while (pTuio->gesture.scroll_x >= pTuio->scroll_distance) {
+            _gesture_click(pInfo, 7);
+            pTuio->gesture.scroll_x -= pTuio->scroll_distance;
+        }
+
+        if (pTuio->gesture.spread > 0 && spread != pTuio->gesture.spread) {
+            pTuio->gesture.zoom *= spread / pTuio->gesture.spread;
+            zoom = pTuio->gesture.zoom * ZOOM_ONE;
+            xf86PostMotionEventP(pInfo->dev,
+                    TRUE, /* is_absolute */
+                    VAL_ZOOM, /* first_valuator */
+                    1, /* num_valuators */
+                    &zoom);
+            pTuio->stats[TUIO_STAT_EVENTS]++;
         }
-        obj = NULL;
     }
 
-    return obj;
+    pTuio->gesture.cx = cx;
+    pTuio->gesture.cy = cy;
+    pTuio->gesture.spread = spread;
 }
 
 /**
@@ -688,11 +3816,13 @@ _subdev_add(InputInfoPtr pInfo, SubDevicePtr subdev) {
     /* First check to see if there are any objects that don't have a 
      * subdevice that we can assign this subdevice to */
     while (obj != NULL) {
-        if (obj->subdev == NULL) {
+        if (obj->subdev == NULL && !obj->rejected && !obj->fresh) {
             obj->subdev = subdev;
             if (pTuio->post_button_events)
                 obj->pending.button = True;
             obj->pending.set = True;
+            if (subdev->parked)
+                _subdev_queue_parking(pInfo);
             return;
         }
         obj = obj->next;
@@ -703,6 +3833,11 @@ _subdev_add(InputInfoPtr pInfo, SubDevicePtr subdev) {
         subdev->next = *subdev_list;
     }
     *subdev_list = subdev;
+    subdev->idle_since = GetTimeInMillis();
+
+    /* Park it until it is needed again */
+    if (!subdev->parked && subdev != pTuio->core_subdev)
+        _subdev_queue_parking(pInfo);
 }
 
 /**
@@ -721,9 +3856,16 @@ _subdev_get(InputInfoPtr pInfo, SubDevicePtr *subdev_list) {
     *subdev_list = subdev->next;
     subdev->next = NULL;
 
+    if (subdev->parked)
+        _subdev_queue_parking(pInfo);
+
     return subdev;
 }
 
+/**
+ * Takes a device out of the subdev list, or away from the object
+ * currently using it.  The SubDeviceRec itself is owned by the device.
+ */
 static void
 _subdev_remove(InputInfoPtr pInfo, InputInfoPtr sub_pInfo)
 {
@@ -737,15 +3879,15 @@ _subdev_remove(InputInfoPtr pInfo, InputInfoPtr sub_pInfo)
     if (subdev != NULL && subdev->pInfo == sub_pInfo) {
         found = True;
         *subdev_list = subdev->next;
-        xfree(subdev);
+        subdev->next = NULL;
     } else if (subdev != NULL) {
         last = subdev;
         subdev = subdev->next;
         while (subdev != NULL) {
             if (subdev->pInfo == sub_pInfo) {
                 last->next = subdev->next;
+                subdev->next = NULL;
                 found = True;
-                xfree(subdev);
                 break;
             }
             last = subdev;
@@ -758,7 +3900,6 @@ _subdev_remove(InputInfoPtr pInfo, InputInfoPtr sub_pInfo)
     if (!found) {
         while (obj != NULL) {
             if (obj->subdev != NULL && obj->subdev->pInfo == sub_pInfo) {
-                xfree(obj->subdev);
                 obj->subdev = NULL;
                 found = True;
                 break;
@@ -766,6 +3907,156 @@ _subdev_remove(InputInfoPtr pInfo, InputInfoPtr sub_pInfo)
             obj = obj->next;
         }
     }
+
+    /* A queued parking run must not enable or disable a subdevice that
+     * is going away; queue a new one for the others */
+    if (found && pTuio->parking_work) {
+        _subdev_cancel_parking(pInfo);
+        _subdev_queue_parking(pInfo);
+    }
+}
+
+/**
+ * Finds a tuio core device by name.  If name is NULL (subdevices created
+ * by older versions of the driver), the first core device is used.
+ *
+ * @return NULL if not found
+ */
+static InputInfoPtr
+_core_find(const char *name)
+{
+    InputInfoPtr pInfo;
+
+    for (pInfo = xf86InputDevs; pInfo != NULL; pInfo = pInfo->next) {
+        if (IS_CORE_DEVICE(pInfo) &&
+            (name == NULL || strcmp(pInfo->name, name) == 0))
+            return pInfo;
+    }
+
+    return NULL;
+}
+
+/**
+ * Schedules _subdev_update_parking() to run from the main loop.  Enabling
+ * and disabling devices is not safe from the SIGIO handler that
+ * TuioReadInput() may be called from.
+ */
+static void
+_subdev_queue_parking(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+    ParkingWorkPtr work;
+
+    if (!pTuio->hide_devices || pTuio->parking_work)
+        return;
+
+    work = xcalloc(1, sizeof(ParkingWorkRec));
+    if (work == NULL)
+        return;
+    work->pInfo = pInfo;
+
+    if (QueueWorkProc(_subdev_update_parking, NULL, work))
+        pTuio->parking_work = work;
+    else
+        xfree(work);
+}
+
+/**
+ * Cancels a queued _subdev_update_parking() and the park timer.  The
+ * work procedure stays queued, but does nothing when it runs.
+ */
+static void
+_subdev_cancel_parking(InputInfoPtr pInfo)
+{
+    TuioDevicePtr pTuio = pInfo->private;
+
+    if (pTuio->parking_work) {
+        pTuio->parking_work->pInfo = NULL;
+        pTuio->parking_work = NULL;
+    }
+    TimerCancel(pTuio->park_timer);
+}
+
+/**
+ * Work procedure that parks idle subdevices and brings back parked
+ * subdevices that have been assigned to an object.  A parked subdevice is
+ * disabled, so it receives no events and has no cursor, instead of being
+ * moved off-screen.  The core device is never parked.
+ *
+ * Every park and unpark sends a device hierarchy event to all clients, so
+ * a subdevice is only parked once it has been idle for PARK_DELAY; one
+ * that is reused before that, e.g. by a double tap, is never disabled.
+ *
+ * @return TRUE, so the work procedure is removed after running once
+ */
+static Bool
+_subdev_update_parking(ClientPtr client, pointer closure)
+{
+    ParkingWorkPtr work = closure;
+    InputInfoPtr pInfo = work->pInfo;
+    TuioDevicePtr pTuio;
+    SubDevicePtr subdev;
+    ObjectPtr obj;
+    CARD32 now, idle, wait = 0;
+    int sigstate;
+
+    xfree(work);
+    if (pInfo == NULL)
+        return TRUE; /* Cancelled */
+
+    pTuio = pInfo->private;
+    sigstate = xf86BlockSIGIO();
+    pTuio->parking_work = NULL;
+    now = GetTimeInMillis();
+
+    for (subdev = pTuio->subdev_list; subdev != NULL; subdev = subdev->next) {
+        if (subdev->parked || subdev == pTuio->core_subdev ||
+            !subdev->pInfo->dev->public.on)
+            continue;
+        idle = now - subdev->idle_since;
+        if (idle < PARK_DELAY) {
+            if (wait == 0 || PARK_DELAY - idle < wait)
+                wait = PARK_DELAY - idle;
+            continue;
+        }
+        subdev->parked = True;
+#if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 7
+        DisableDevice(subdev->pInfo->dev, TRUE);
+#else
+        DisableDevice(subdev->pInfo->dev);
+#endif
+    }
+
+    for (obj = pTuio->obj_list; obj != NULL; obj = obj->next) {
+        if (!obj->subdev || !obj->subdev->parked)
+            continue;
+#if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 7
+        EnableDevice(obj->subdev->pInfo->dev, TRUE);
+#else
+        EnableDevice(obj->subdev->pInfo->dev);
+#endif
+        obj->subdev->parked = False;
+
+        /* Post what was held back while the subdevice was parked */
+        _object_post(pTuio, obj);
+    }
+
+    if (wait > 0)
+        pTuio->park_timer = TimerSet(pTuio->park_timer, 0, wait,
+                                     _park_timer, pInfo);
+
+    xf86UnblockSIGIO(sigstate);
+    return TRUE;
+}
+
+/**
+ * Queues another parking run once the idle subdevices are due
+ */
+static CARD32
+_park_timer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    _subdev_queue_parking(arg);
+    return 0;
 }
 
 /**
@@ -781,16 +4072,21 @@ _init_buttons(DeviceIntPtr device)
     int                 ret = Success;
     int i;
 
-    map = xcalloc(numbuttons, sizeof(CARD8));
+    if (IS_CORE_DEVICE(pInfo) &&
+        ((TuioDevicePtr)pInfo->private)->gestures)
+        numbuttons = NUM_GESTURE_BUTTONS;
+
+    /* The button map is indexed from 1 */
+    map = xcalloc(numbuttons + 1, sizeof(CARD8));
     labels = xcalloc(numbuttons, sizeof(Atom));
-    for (i=0; i<numbuttons; i++)
+    for (i=0; i<=numbuttons; i++)
         map[i] = i;
 
     //map = xcalloc(1, sizeof(CARD8));
     //*map = 3;
     //label = XIGetKnownProperty("Button Left");
 
-    if (!InitButtonClassDeviceStruct(device, numbuttons/* 1 button */,
+    if (!InitButtonClassDeviceStruct(device, numbuttons,
 #if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 7
                                      labels,
 #endif
@@ -800,6 +4096,7 @@ _init_buttons(DeviceIntPtr device)
     }
 
     xfree(labels);
+    xfree(map);
     return ret;
 }
 
@@ -840,8 +4137,8 @@ _init_axes(DeviceIntPtr device)
         xf86InitValuatorDefaults(device, i);
     }
 
-    /* Setup velocity and acceleration axes */
-    for (i = 2; i < 6; i++)
+    /* Setup velocity, acceleration and zoom axes */
+    for (i = 2; i < num_axes; i++)
     {
         xf86InitValuatorAxisStruct(device, i,
 #if GET_ABI_MAJOR(ABI_XINPUT_VERSION) >= 7
@@ -954,6 +4251,18 @@ _hal_create_devices(InputInfoPtr pInfo, int num) {
             return 1;
         }
 
+        /* Set "Core" property, so the subdevice only routes events
+         * for this device */
+        dbus_error_init(&error);
+        libhal_device_set_property_string(ctx, newdev,
+                "input.x11_options.Core",
+                pInfo->name, &error);
+        if (dbus_error_is_set(&error) == TRUE) {
+            xf86Msg(X_ERROR, "%s: Failed to set hal property: %s\n",
+                    pInfo->name, error.message);
+            return 1;
+        }
+
         asprintf(&name, "%s subdev %i", pInfo->name, pTuio->num_subdev);
 
         /* Set name */
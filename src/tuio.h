@@ -26,11 +26,16 @@
 #ifndef TUIO_H 
 #define TUIO_H 
 
+#include <sys/socket.h>
 #include <X11/extensions/XI.h>
 #include <xf86Xinput.h>
 #include <lo/lo.h>
 #include <hal/libhal.h>
 
+#include "tuio-properties.h"
+#include "tuio-shm.h"
+#include "tuio-ring.h"
+
 #ifndef Bool
 #define Bool int
 #endif
@@ -46,6 +51,28 @@
 #define DEFAULT_SUBDEVICES 0
 #define DEFAULT_PORT 3333 /* Default UDP port to listen on */
 #define DEFAULT_FSEQ_THRESHOLD 100 /* Default UDP port to listen on */
+#define TUIO_MAX_PACKET 65536 /* Largest OSC packet we read */
+#define DEFAULT_RCVBUF 0 /* Socket receive buffer size, 0 = system default */
+#define MAX_STREAMS 8 /* Max trackers connected to a stream transport */
+#define MAX_ENDPOINTS 8 /* Max addresses of Option "Listen" */
+#define MAX_SENDERS 16 /* Trackers told apart per datagram socket */
+#define MAX_READ_EVENTS 16 /* Ready sources handled per epoll_wait() */
+#define MAX_BACKLOG_DROP 4096 /* Max packets discarded at once */
+#define BACKLOG_STASH (4 * TUIO_MAX_PACKET) /* Newest frame kept by "newest" */
+#define TUIO_MAX_SOURCES 32 /* Max number of AllowedSources */
+#define DEFAULT_GRID_SIZE 10 /* Region filter cells per axis */
+#define MAX_GRID_SIZE 64
+#define MAX_DEAD_ZONES 16
+#define DEFAULT_MAX_SESSIONS 512 /* Sessions tracked at once */
+#define MAX_SESSIONS 1024
+#define WHEEL_SLOTS 64 /* Session watchdog timer wheel, a power of two */
+#define MIN_WATCHDOG_TICK 10 /* ms */
+#define DRAIN_INTERVAL 100 /* ms between reads while the device is off */
+#define PARK_DELAY 1000 /* ms a subdevice stays idle before it is parked */
+#define CLOCK_WINDOW 128 /* Bundles per tracker clock offset estimate */
+#define NTP_EPOCH_OFFSET 2208988800LL /* OSC timetags count from 1900 */
+#define DEFAULT_SCROLL_DISTANCE 0.05 /* Fraction of the surface per scroll
+                                        button click */
 
 /* Valuators */
 #define NUM_VALUATORS 4
@@ -53,31 +80,249 @@
 #define VAL_Y_VELOCITY "Y Velocity"
 #define VAL_ACCELERATION "Acceleration"
 
+/* Gestures are posted on the core device: scroll as buttons 4-7, zoom as
+ * a 16.16 fixed point scale factor on the last valuator */
+#define NUM_GESTURE_BUTTONS 7
+#define VAL_ZOOM 4
+#define ZOOM_ONE 0x10000
+
+/* Transports the TUIO packets arrive on */
+#define TRANSPORT_UDP 0
+#define TRANSPORT_UNIX 1 /* Unix datagram socket */
+#define TRANSPORT_UNIX_STREAM 2 /* Unix stream socket, length prefixed */
+#define TRANSPORT_TCP 3 /* TCP, length prefixed */
+#define TRANSPORT_SHM 4 /* Shared memory ring, see tuio-ring.h */
+
+/* Kinds of file descriptors packets are read from */
+#define SOURCE_DGRAM 0 /* One packet per datagram */
+#define SOURCE_LISTEN 1 /* Accepts stream connections */
+#define SOURCE_STREAM 2 /* Packets prefixed by their 32 bit length */
+#define SOURCE_RING 3 /* eventfd signalling packets in the ingest ring */
+#define SOURCE_SENDER 4 /* A tracker sending to a datagram socket, no fd */
+
+typedef struct _Source {
+    struct _Source *next;
+    int type; /* SOURCE_* */
+    int fd;
+
+    /* Stream sources: received bytes not yet dispatched */
+    char *buf;
+    int len;
+    Bool backlog; /* Complete packets left by the read budget */
+
+    int endpoint; /* Listen endpoint it came from, -1 if none */
+    CARD32 rxq_dropped; /* Kernel drop count of the socket last seen */
+
+    /* Datagram sources: each sender address is a source of its own, most
+     * recently heard first, so trackers sharing a socket have their own
+     * touches, SourceTimeout and clock estimate */
+    struct _Source *senders;
+    int num_senders;
+    struct sockaddr_storage addr; /* Of a sender */
+    socklen_t addrlen;
+
+    CARD32 seen; /* Time of the last packet, for SourceTimeout */
+    Bool timed_out; /* SourceTimeout has been handled */
+    Bool committed; /* A frame has been committed, fseq is set */
+    int fseq; /* Of the last frame committed */
+    uint64_t frame_timetag; /* Of the last frame committed, 0 if none */
+
+    /* Clock estimate of the tracker sending to it, all in microseconds
+     * of wall clock time */
+    struct {
+        int64_t window_min; /* Smallest offset in the current window */
+        int window_count;
+        int64_t offset; /* Offset estimated at the end of a window */
+        int64_t time; /* When it was estimated */
+        double drift;
+        Bool valid;
+    } clock;
+} SourceRec, *SourcePtr;
+
+/* Which session makes room for a new one at MaxSessions */
+#define EVICT_LRU 0 /* Least recently updated */
+#define EVICT_OLDEST 1 /* First seen */
+
+/* What TuioReadInput() does with queued packets when its budget is used */
+#define BACKLOG_YIELD 0 /* Leave them for later */
+#define BACKLOG_NEWEST 1 /* Discard all but the newest frame */
+#define BACKLOG_OLDEST 2 /* Discard a budget's worth, leave the rest */
+
+/* How a region filter grid cell is covered by dead zones */
+#define CELL_LIVE 0
+#define CELL_DEAD 1
+#define CELL_PARTIAL 2 /* Needs a check against the dead zones */
+
+typedef struct _GridCell {
+    unsigned short count; /* Objects currently in the cell */
+    unsigned char zone; /* CELL_* */
+} GridCellRec, *GridCellPtr;
+
+typedef struct _DeadZone {
+    float x0, y0, x1, y1;
+} DeadZoneRec;
+
 /**
  * Tuio device information, including list of current object
  */
 typedef struct _TuioDevice {
     lo_server server;
 
+    /* fseq of the packet being handled and of the last frame committed
+     * from its source */
     int fseq_new, fseq_old;
     int processed;
 
     int num_subdev;
 
     struct _Object *obj_list;
+    int num_sessions; /* Objects in obj_list */
 
     /* List of unused devices that can be allocated for use
      * with ObjectPtr. */
     struct _SubDevice *subdev_list;
 
+    /* The core device routes events too, this is its list entry */
+    struct _SubDevice *core_subdev;
+
+    /* Dummy pipe shared by the subdevices of this core device */
+    int subdev_pipe[2];
+
+    /* Queued _subdev_update_parking(), NULL if none */
+    struct _ParkingWork *parking_work;
+    OsTimerPtr park_timer; /* Parks subdevices once PARK_DELAY is up */
+
     /* Remaining variables are set by "Option" values */
     int tuio_port;
+    int transport; /* TRANSPORT_* */
+    char *transport_path; /* Socket path of the unix transports */
     int init_num_subdev;
     Bool post_button_events;
-    Bool hide_devices;
+    Bool hide_devices; /* Park idle subdevices */
     int fseq_threshold; /* Maximum difference between consecutive fseq values
                            that will allow a packet to be dropped */
     Bool dynadd_subdev;
+    Bool gestures;
+    float scroll_distance;
+    int max_frame_rate; /* Motion frames posted per second, 0 = no limit */
+    int max_frame_age; /* ms after which frames are stale, 0 = no limit */
+    int rcvbuf; /* Requested receive buffer size in bytes */
+    char *mcast_group; /* Multicast group to join, NULL for unicast */
+    char *mcast_iface; /* Interface name or address to join it on */
+    Bool socket_filter;
+    CARD32 allowed_sources[TUIO_MAX_SOURCES]; /* IPv4, host byte order */
+    int num_allowed_sources;
+
+    DeadZoneRec dead_zones[MAX_DEAD_ZONES];
+    int num_dead_zones;
+    int palm_contacts; /* Objects per cell that make a palm, 0 = off */
+
+    int read_budget; /* Packets per TuioReadInput() call, 0 = no limit */
+    int read_time; /* Microseconds per TuioReadInput() call, 0 = no limit */
+    int backlog_policy; /* BACKLOG_* */
+    Bool budget_hit; /* The current TuioReadInput() call used its budget */
+    char *backlog_stash; /* Packets of the newest frame, BACKLOG_NEWEST */
+
+    int max_sessions;
+    int eviction_policy; /* EVICT_* */
+    Bool evict_logged;
+
+    /* Watchdog, releasing touches of silent trackers and sessions.
+     * Objects are kept in a timer wheel by the time they expire; they are
+     * only moved when their slot comes up, not on every update. */
+    int session_timeout; /* ms, 0 = off */
+    int source_timeout; /* ms, 0 = off */
+    int watchdog_tick; /* ms per wheel slot */
+    struct _Object *wheel[WHEEL_SLOTS];
+    CARD32 wheel_time; /* Start of the next slot to expire */
+    OsTimerPtr watchdog_timer;
+    Bool watchdog_armed;
+    struct _Source *source; /* Source of the packet being handled */
+
+    float calibration[9]; /* Row-major 3x3 matrix */
+    int output_range[4]; /* x min, x max, y min, y max */
+
+    /* Calibration and output range folded into one transform.  Affine
+     * transforms use 48.16 fixed point coefficients, applied to positions
+     * in 16.16 fixed point. */
+    struct {
+        Bool projective;
+        int64_t x[3], y[3]; /* Position, in valuator units */
+        int64_t vx[2], vy[2]; /* Velocity, rotation and scale only */
+    } transform;
+
+    char *shm_name; /* Shared memory object frames are published in */
+    TuioShmHeader *shm;
+
+    OsTimerPtr flush_timer; /* Posts motion held back by MaxFrameRate */
+    Bool flush_armed;
+    CARD32 flush_due; /* _time_us() from which motion may be posted again */
+    OsTimerPtr resume_timer; /* Reads the rest of a backlog */
+    OsTimerPtr drain_timer; /* Discards packets while suspended */
+    Bool suspended; /* Off, with the sockets kept open */
+
+    /* Region filter, grid_size x grid_size cells over the normalised
+     * surface, NULL when there are no dead zones or palm rejection */
+    GridCellPtr grid;
+    int grid_size;
+
+    /* Gesture recognizer state, updated once per committed frame */
+    struct {
+        Bool active; /* Two touches in this and the previous frame */
+        int touches;
+        float cx, cy; /* Centroid */
+        float spread; /* Distance of the touches from the centroid */
+        float scroll_x, scroll_y; /* Movement not yet posted as a click */
+        float zoom; /* Scale since the gesture started */
+    } gesture;
+
+    /* Counters exported through the statistics property,
+     * indexed by TUIO_STAT_* */
+    CARD32 stats[TUIO_STAT_COUNT];
+    CARD32 latency[TUIO_LATENCY_BUCKETS];
+    Atom prop_stats;
+    Atom prop_latency;
+    Atom prop_listen_stats;
+    Atom prop_calibration;
+    Atom prop_range;
+    Bool updating_props; /* _get_property() refreshes a read-only one */
+
+    char *recv_buf;
+
+    /* Sockets packets are read from.  With more than one, they are
+     * watched through epoll_fd, which then is the fd of the device. */
+    SourcePtr sources;
+    int num_streams;
+    int epoll_fd;
+
+    /* Addresses of Option "Listen", each with its own socket.  Their
+     * counters are laid out as the "Tuio Listen Statistics" property. */
+    char *endpoint_names[MAX_ENDPOINTS];
+    struct sockaddr_storage endpoints[MAX_ENDPOINTS];
+    socklen_t endpoint_lens[MAX_ENDPOINTS];
+    int num_endpoints;
+    CARD32 endpoint_stats[MAX_ENDPOINTS * TUIO_LISTEN_STAT_COUNT];
+
+    /* Shared memory ingest ring and its eventfd, handed to the producer */
+    TuioRingHeader *ring;
+    int ring_fd;
+    int ring_event;
+    CARD32 ring_dropped; /* Producer drop count last seen */
+
+    /* Packets read and start of the current TuioReadInput() call */
+    int read_packets;
+    CARD32 read_start;
+
+    /* Arrival time of the last packet read, and how much later than
+     * an undelayed packet it arrived according to its timetag */
+    CARD32 packet_rx;
+    CARD32 packet_net_age;
+
+    /* Same for the first packet of the current frame */
+    CARD32 frame_start;
+    CARD32 frame_net_age;
+    Bool frame_started;
+    Bool drop_motion; /* The frame being committed is too old */
 
 } TuioDeviceRec, *TuioDevicePtr;
 
@@ -91,9 +336,18 @@ typedef struct _Object {
     int id;
     float xpos, ypos;
     float xvel, yvel;
-    int alive;
+    int alive; /* Listed by the alive message being handled */
+    int valuators[NUM_VALUATORS]; /* Last posted, calibrated */
+    Bool dirty; /* Moved, but the motion has not been posted yet */
+    Bool fresh; /* Not committed yet, so not checked by the region filter */
+    Bool rejected; /* Dead zone or palm, never gets a subdevice */
+    int cell; /* Region filter cell, -1 if none */
     struct _SubDevice *subdev;
 
+    CARD32 seen; /* Last listed in an alive or set message */
+    struct _Source *source; /* Source of the last such message */
+    struct _Object *wheel_next, **wheel_prev; /* Watchdog wheel slot */
+
     /* Stores pending information about this object */
     struct {
         Bool alive;
@@ -101,19 +355,32 @@ typedef struct _Object {
         Bool button;
         float xpos, ypos;
         float xvel, yvel;
+        int valuators[NUM_VALUATORS];
     } pending;
 } ObjectRec, *ObjectPtr;
 
 /**
- * Subdevices are special devices created at the creation of the first
- * tuio device (aka "core" device).  They are tuio devices but are only used 
- * to route object movements through.
+ * Subdevices are special devices created by a tuio device (aka "core"
+ * device).  They are tuio devices but are only used to route object
+ * movements through.  A subdevice's pInfo->private points to its
+ * SubDeviceRec, and it only ever routes events for its own core device.
  */
 typedef struct _SubDevice {
     struct _SubDevice *next;
 
     InputInfoPtr pInfo;
+    InputInfoPtr core; /* NULL once the core device is gone */
+    Bool parked; /* Disabled while idle, see PseudoHide */
+    CARD32 idle_since; /* When it was put back in the subdev list */
 } SubDeviceRec, *SubDevicePtr;
 
+/**
+ * Closure of a queued _subdev_update_parking().  Work procedures can't be
+ * taken off the queue, so a run is cancelled by clearing pInfo.
+ */
+typedef struct _ParkingWork {
+    InputInfoPtr pInfo; /* Core device, NULL if cancelled */
+} ParkingWorkRec, *ParkingWorkPtr;
+
 #endif
 
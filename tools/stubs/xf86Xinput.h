@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * The parts of the X server input driver API the tuio driver uses, for
+ * building it into the test programs without a server.  Declarations
+ * follow the xserver 1.7 SDK (XInput ABI 7); tuio-stubs.c has the
+ * implementations.
+ */
+
+#ifndef _XF86XINPUT_H
+#define _XF86XINPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include <X11/Xdefs.h>
+#include <X11/Xmd.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XI.h>
+
+#define _X_EXPORT
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+/* Module loader */
+#define MODULEVENDORSTRING "X.Org Foundation"
+#define MODINFOSTRING1 0xef23fdc5
+#define MODINFOSTRING2 0x10dc023a
+#define XORG_VERSION_CURRENT 10700000
+#define ABI_CLASS_XINPUT "X.Org XInput driver"
+#define SET_ABI_VERSION(maj, min) ((maj) << 16 | (min))
+#define GET_ABI_MAJOR(v) ((v) >> 16)
+#define ABI_XINPUT_VERSION SET_ABI_VERSION(7, 0)
+#define MOD_CLASS_XINPUT "X.Org XInput Driver"
+
+#ifndef PACKAGE_VERSION_MAJOR
+#define PACKAGE_VERSION_MAJOR 0
+#define PACKAGE_VERSION_MINOR 1
+#define PACKAGE_VERSION_PATCHLEVEL 0
+#endif
+
+typedef struct {
+    const char *modname;
+    const char *vendor;
+    CARD32 _modinfo1_;
+    CARD32 _modinfo2_;
+    CARD32 xf86version;
+    CARD8 majorversion;
+    CARD8 minorversion;
+    CARD16 patchlevel;
+    const char *abiclass;
+    CARD32 abiversion;
+    const char *moduleclass;
+    CARD32 checksum[4];
+} XF86ModuleVersionInfo;
+
+typedef pointer (*ModuleSetupProc)(pointer, pointer, int *, int *);
+typedef void (*ModuleTearDownProc)(pointer);
+
+typedef struct {
+    XF86ModuleVersionInfo *vers;
+    ModuleSetupProc setup;
+    ModuleTearDownProc teardown;
+} XF86ModuleData;
+
+/* Logging */
+typedef enum {
+    X_PROBED, X_CONFIG, X_DEFAULT, X_CMDLINE, X_NOTICE, X_ERROR, X_WARNING,
+    X_INFO, X_NONE, X_NOT_IMPLEMENTED, X_UNKNOWN = -1
+} MessageType;
+
+extern void xf86Msg(MessageType type, const char *format, ...);
+
+/* Memory */
+extern pointer xalloc(unsigned long size);
+extern pointer xcalloc(unsigned long num, unsigned long size);
+extern pointer xrealloc(pointer ptr, unsigned long size);
+extern void xfree(pointer ptr);
+extern char *xstrdup(const char *s);
+
+/* Timers and work procedures */
+typedef struct _OsTimerRec *OsTimerPtr;
+typedef CARD32 (*OsTimerCallback)(OsTimerPtr timer, CARD32 time,
+                                  pointer arg);
+
+extern OsTimerPtr TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
+                           OsTimerCallback func, pointer arg);
+extern void TimerCancel(OsTimerPtr timer);
+extern void TimerFree(OsTimerPtr timer);
+extern CARD32 GetTimeInMillis(void);
+
+typedef struct _Client *ClientPtr;
+
+extern Bool QueueWorkProc(Bool (*function)(ClientPtr client, pointer closure),
+                          ClientPtr client, pointer closure);
+
+/* Devices */
+#define DEVICE_INIT 0
+#define DEVICE_ON 1
+#define DEVICE_OFF 2
+#define DEVICE_CLOSE 3
+
+#define Absolute 1
+
+typedef struct _DeviceIntRec *DeviceIntPtr;
+typedef int (*DeviceProc)(DeviceIntPtr device, int what);
+
+typedef struct _ValuatorClassRec {
+    int numAxes;
+    CARD8 mode;
+} ValuatorClassRec, *ValuatorClassPtr;
+
+typedef struct _PropertyValue {
+    Atom type;
+    short format;
+    long size;
+    pointer data;
+} XIPropertyValueRec, *XIPropertyValuePtr;
+
+typedef int (*XISetPropertyProc)(DeviceIntPtr dev, Atom property,
+                                 XIPropertyValuePtr prop, BOOL checkonly);
+typedef int (*XIGetPropertyProc)(DeviceIntPtr dev, Atom property);
+typedef int (*XIDeletePropertyProc)(DeviceIntPtr dev, Atom property);
+
+typedef struct _DeviceIntRec {
+    struct {
+        pointer devicePrivate;
+        Bool on;
+    } public;
+    int id;
+    char *name;
+    Bool enabled;
+    DeviceProc deviceProc;
+    ValuatorClassPtr valuator;
+
+    /* Property handler of the driver, and the properties it set */
+    XISetPropertyProc set_property;
+    XIGetPropertyProc get_property;
+    struct _StubProperty *properties;
+} DeviceIntRec;
+
+extern Bool EnableDevice(DeviceIntPtr device, BOOL sendevent);
+extern Bool DisableDevice(DeviceIntPtr device, BOOL sendevent);
+
+extern Bool InitButtonClassDeviceStruct(DeviceIntPtr device, int numButtons,
+                                        Atom *labels, CARD8 *map);
+extern Bool InitValuatorClassDeviceStruct(DeviceIntPtr device, int numAxes,
+                                          Atom *labels, int numMotionEvents,
+                                          int mode);
+extern Bool InitAbsoluteClassDeviceStruct(DeviceIntPtr device);
+extern int GetMotionHistorySize(void);
+
+/* Properties */
+extern Atom MakeAtom(const char *string, unsigned len, Bool makeit);
+extern Atom XIGetKnownProperty(char *name);
+extern int XIChangeDeviceProperty(DeviceIntPtr dev, Atom property, Atom type,
+                                  int format, int mode, unsigned long len,
+                                  pointer value, Bool sendevent);
+extern int XISetDevicePropertyDeletable(DeviceIntPtr dev, Atom property,
+                                        Bool deletable);
+extern long XIRegisterPropertyHandler(DeviceIntPtr dev,
+                                      XISetPropertyProc SetProperty,
+                                      XIGetPropertyProc GetProperty,
+                                      XIDeletePropertyProc DeleteProperty);
+
+/* Input drivers */
+#define XI86_OPEN_ON_INIT 0x02
+#define XI86_CONFIGURED 0x04
+
+typedef struct _IDevRec {
+    char *identifier;
+    char *driver;
+    pointer commonOptions;
+    pointer extraOptions;
+} IDevRec, *IDevPtr;
+
+typedef struct _InputDriverRec *InputDriverPtr;
+typedef struct _InputInfoRec *InputInfoPtr;
+
+typedef struct _InputDriverRec {
+    int driverVersion;
+    char *driverName;
+    void (*Identify)(int flags);
+    InputInfoPtr (*PreInit)(InputDriverPtr drv, IDevPtr dev, int flags);
+    void (*UnInit)(InputDriverPtr drv, InputInfoPtr pInfo, int flags);
+    pointer module;
+    int refCount;
+} InputDriverRec;
+
+typedef struct _InputInfoRec {
+    struct _InputInfoRec *next;
+    char *name;
+    int flags;
+    const char *type_name;
+    InputDriverPtr drv;
+    pointer module;
+    pointer options;
+    DeviceIntPtr dev;
+    pointer private;
+    IDevPtr conf_idev;
+    int fd;
+    void (*read_input)(InputInfoPtr pInfo);
+    int (*device_control)(DeviceIntPtr device, int what);
+    int (*switch_mode)(ClientPtr client, DeviceIntPtr dev, int mode);
+} InputInfoRec;
+
+extern InputInfoPtr xf86InputDevs;
+
+extern void xf86AddInputDriver(InputDriverPtr driver, pointer module,
+                               int flags);
+extern InputInfoPtr xf86AllocateInput(InputDriverPtr drv, int flags);
+extern void xf86DeleteInput(InputInfoPtr pInp, int flags);
+extern void xf86CollectInputOptions(InputInfoPtr pInfo,
+                                    const char **defaultOpts,
+                                    pointer extraOpts);
+extern void xf86ProcessCommonOptions(InputInfoPtr pInfo, pointer options);
+
+/* Options, commonOptions is a NULL terminated array of name, value pairs */
+extern char *xf86CheckStrOption(pointer optlist, const char *name,
+                                char *deflt);
+extern char *xf86SetStrOption(pointer optlist, const char *name, char *deflt);
+extern int xf86CheckIntOption(pointer optlist, const char *name, int deflt);
+extern int xf86SetIntOption(pointer optlist, const char *name, int deflt);
+extern Bool xf86CheckBoolOption(pointer optlist, const char *name, int deflt);
+extern double xf86SetRealOption(pointer optlist, const char *name,
+                                double deflt);
+extern int xf86NameCmp(const char *s1, const char *s2);
+
+/* Input and events */
+extern int xf86WaitForInput(int fd, int timeout);
+extern void xf86FlushInput(int fd);
+extern void xf86AddEnabledDevice(InputInfoPtr pInfo);
+extern void xf86RemoveEnabledDevice(InputInfoPtr pInfo);
+extern void AddEnabledDevice(int fd);
+extern void RemoveEnabledDevice(int fd);
+extern int xf86BlockSIGIO(void);
+extern void xf86UnblockSIGIO(int wasset);
+
+extern void xf86PostMotionEventP(DeviceIntPtr device, int is_absolute,
+                                 int first_valuator, int num_valuators,
+                                 int *valuators);
+extern void xf86PostButtonEvent(DeviceIntPtr device, int is_absolute,
+                                int button, int is_down, int first_valuator,
+                                int num_valuators, ...);
+
+extern void xf86InitValuatorAxisStruct(DeviceIntPtr dev, int axnum,
+                                       Atom label, int minval, int maxval,
+                                       int resolution, int min_res,
+                                       int max_res);
+extern void xf86InitValuatorDefaults(DeviceIntPtr dev, int i);
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# Sweeps tuio-loadgen over a range of live object counts and prints one
+# machine readable result line per run.
+#
+# Usage: tuio-bench.sh device [rate] [seconds]
+#
+# TRANSPORT and HOST select the transport and destination (the socket path
+# for the unix and shm transports), to compare transports under the same load.
+#
+# The device must track as many sessions as the largest step, which the
+# default MaxSessions does; otherwise that step measures session evictions.
+
+LOADGEN=${LOADGEN:-tuio-loadgen}
+DEVICE=$1
+RATE=${2:-200}
+DURATION=${3:-5}
+TRANSPORT=${TRANSPORT:-udp}
+HOST=${HOST:-127.0.0.1}
+
+if [ -z "$DEVICE" ]; then
+    echo "Usage: $0 device [rate] [seconds]" >&2
+    exit 1
+fi
+
+for touches in 1 10 50 500; do
+    $LOADGEN -m -x "$TRANSPORT" -h "$HOST" -d "$DEVICE" -n $touches \
+        -r $RATE -t $DURATION || exit $?
+done
@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * tuio-harness: runs the driver against the stub X server of
+ * tuio-stubs.c, without an X server, a tracker or HAL.
+ *
+ * Each scenario creates a core device listening on a UDP port of its own
+ * and a subdevice per touch, sends scripted /tuio/2Dcur frames to it over
+ * the loopback and measures the time from sending a frame to each event
+ * it posts.  A few checks run the same way.  The exit status is 1 if a
+ * check fails, so "make check" can run it.
+ */
+
+/* The driver is built into the harness against the stub headers, its
+ * config.h would bring in the server SDK */
+#undef HAVE_CONFIG_H
+#include "tuio.c"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tuio-stubs.h"
+
+#define FRAME_RATE 500 /* Frames per second sent */
+#define MAX_OPTIONS 16
+#define SESSION_BASE 1000 /* Offset of the first session id */
+
+typedef struct _Scenario {
+    const char *name;
+    int num_touches;
+    int frames;
+    int split; /* Max number of set messages per packet, 0 = whole frame */
+    const char *max_frame_rate; /* MaxFrameRate option, NULL for none */
+} ScenarioRec, *ScenarioPtr;
+
+static const ScenarioRec scenarios[] = {
+    { "1-touch", 1, 250, 0, NULL },
+    { "10-touch", 10, 250, 0, NULL },
+    { "50-touch", 50, 250, 0, NULL },
+    { "50-touch-split", 50, 250, 8, NULL },
+    { "10-touch-60hz", 10, 250, 0, "60" },
+};
+
+/* A core device, its subdevices and the trackers sending to it */
+typedef struct _Harness {
+    DeviceIntPtr core;
+    DeviceIntPtr subdevs[STUB_MAX_TOUCHES];
+    int num_subdevs;
+    const char *options[MAX_OPTIONS];
+    const char *sub_options[5];
+    struct sockaddr_in addr;
+    int socks[2];
+    int32_t fseq[2];
+    int64_t sent; /* When the last frame was sent */
+
+    /* Events posted, and their latency in ns */
+    unsigned long motion;
+    unsigned long downs;
+    unsigned long ups;
+    unsigned long clicks; /* Scroll clicks on the core device */
+    int64_t *latency;
+    int num_latency;
+    int max_latency;
+} HarnessRec, *HarnessPtr;
+
+static int failures;
+
+static Bool _harness_open(HarnessPtr h, const char *name, int num_subdevs,
+                          const char **options);
+static void _harness_close(HarnessPtr h);
+static void _frame_send(HarnessPtr h, int tracker, StubTouchPtr touches,
+                        int num_touches, int split);
+static void _frame_wait(HarnessPtr h);
+static void _events_collect(HarnessPtr h);
+static int _latency_cmp(const void *a, const void *b);
+static double _latency_percentile(HarnessPtr h, double q);
+static void _touches_move(StubTouchPtr touches, int num_touches, int frame);
+static void _fail(const char *scenario, const char *format, ...);
+static void _run_scenario(const ScenarioRec *sc);
+static void _check_statistics(void);
+static void _check_trackers(void);
+static void _check_gesture(void);
+
+/**
+ * Creates a core device with num_subdevs subdevices, listening on a UDP
+ * port of its own on the loopback, and two trackers to send to it
+ *
+ * @param options NULL terminated option name and value pairs, or NULL
+ */
+static Bool
+_harness_open(HarnessPtr h, const char *name, int num_subdevs,
+              const char **options)
+{
+    InputInfoPtr pInfo;
+    socklen_t len = sizeof(h->addr);
+    char subname[64];
+    int i = 0;
+
+    memset(h, 0, sizeof(HarnessRec));
+    h->options[i++] = "Port";
+    h->options[i++] = "0";
+    while (options && *options && i < MAX_OPTIONS - 1)
+        h->options[i++] = *options++;
+    h->options[i] = NULL;
+
+    if (!(h->core = stub_device_new(name, h->options)) ||
+        !EnableDevice(h->core, TRUE)) {
+        _fail(name, "core device can't be created\n");
+        return FALSE;
+    }
+    pInfo = h->core->public.devicePrivate;
+
+    h->sub_options[0] = "Type";
+    h->sub_options[1] = "Object";
+    h->sub_options[2] = "Core";
+    h->sub_options[3] = name;
+    h->sub_options[4] = NULL;
+    for (i = 0; i < num_subdevs && i < STUB_MAX_TOUCHES; i++) {
+        snprintf(subname, sizeof(subname), "%s subdev %i", name, i);
+        h->subdevs[i] = stub_device_new(subname, h->sub_options);
+        if (h->subdevs[i] == NULL || !EnableDevice(h->subdevs[i], TRUE)) {
+            _fail(name, "subdevice %i can't be created\n", i);
+            return FALSE;
+        }
+        h->num_subdevs++;
+    }
+
+    if (getsockname(pInfo->fd, (struct sockaddr *)&h->addr, &len) == -1) {
+        _fail(name, "no UDP socket\n");
+        return FALSE;
+    }
+    h->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (i = 0; i < 2; i++) {
+        if ((h->socks[i] = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+            _fail(name, "socket: %s\n", strerror(errno));
+            return FALSE;
+        }
+        h->fseq[i] = 1;
+    }
+
+    stub_events_clear();
+    return TRUE;
+}
+
+static void
+_harness_close(HarnessPtr h)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+        if (h->socks[i] > 0)
+            close(h->socks[i]);
+    for (i = 0; i < h->num_subdevs; i++)
+        stub_device_free(h->subdevs[i]);
+    if (h->core)
+        stub_device_free(h->core);
+    free(h->latency);
+}
+
+/**
+ * Sends a frame of a tracker, split into packets of at most split set
+ * messages.  The first packet has the alive message, the last one the
+ * fseq message.
+ */
+static void
+_frame_send(HarnessPtr h, int tracker, StubTouchPtr touches,
+            int num_touches, int split)
+{
+    static char buf[TUIO_MAX_PACKET];
+    int first = 0, flags, len;
+
+    if (split <= 0 || split > num_touches)
+        split = num_touches > 0 ? num_touches : 1;
+
+    h->sent = stub_now();
+    do {
+        flags = first == 0 ? STUB_ALIVE : 0;
+        if (first + split >= num_touches)
+            flags |= STUB_FSEQ;
+        len = stub_frame(buf, touches, num_touches, first, split, flags,
+                         h->fseq[tracker]);
+        if (sendto(h->socks[tracker], buf, len, 0,
+                   (struct sockaddr *)&h->addr, sizeof(h->addr)) != len)
+            _fail("send", "sendto: %s\n", strerror(errno));
+        first += split;
+    } while (first < num_touches);
+    h->fseq[tracker]++;
+}
+
+/**
+ * Runs the main loop until the next frame is due, then collects the
+ * events posted since the last frame was sent
+ */
+static void
+_frame_wait(HarnessPtr h)
+{
+    stub_wait(h->core->public.devicePrivate,
+              h->sent + 1000000000 / FRAME_RATE);
+    _events_collect(h);
+}
+
+/**
+ * Counts the events in the event log, and adds their latency from the
+ * last frame sent.  Motion held back by MaxFrameRate is posted by a timer
+ * later; its latency is also counted from the last frame, whose position
+ * it posts.
+ */
+static void
+_events_collect(HarnessPtr h)
+{
+    StubEventPtr ev;
+    int64_t *latency;
+    int i, n = min(stub_num_events, STUB_MAX_EVENTS);
+
+    if (stub_num_events > STUB_MAX_EVENTS)
+        _fail("events", "%i events not logged\n",
+              stub_num_events - STUB_MAX_EVENTS);
+
+    if (h->num_latency + n > h->max_latency) {
+        h->max_latency = (h->num_latency + n) * 2;
+        latency = realloc(h->latency, h->max_latency * sizeof(int64_t));
+        if (latency == NULL) {
+            _fail("events", "out of memory\n");
+            stub_events_clear();
+            return;
+        }
+        h->latency = latency;
+    }
+
+    for (i = 0; i < n; i++) {
+        ev = &stub_events[i];
+        if (ev->type == STUB_MOTION && ev->first_valuator == 0)
+            h->motion++;
+        else if (ev->type == STUB_BUTTON && ev->dev == h->core &&
+                 ev->button > 3)
+            h->clicks += ev->is_down;
+        else if (ev->type == STUB_BUTTON && ev->is_down)
+            h->downs++;
+        else if (ev->type == STUB_BUTTON)
+            h->ups++;
+        h->latency[h->num_latency++] = ev->time - h->sent;
+    }
+    stub_events_clear();
+}
+
+static int
+_latency_cmp(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @return the q quantile of the event latencies, in us
+ */
+static double
+_latency_percentile(HarnessPtr h, double q)
+{
+    if (h->num_latency == 0)
+        return 0;
+    qsort(h->latency, h->num_latency, sizeof(int64_t), _latency_cmp);
+    return h->latency[(int)((h->num_latency - 1) * q)] / 1000.0;
+}
+
+/**
+ * Each touch moves on its own circle around the center of the surface
+ */
+static void
+_touches_move(StubTouchPtr touches, int num_touches, int frame)
+{
+    double t = (double)frame / FRAME_RATE, phase, r;
+    int i;
+
+    for (i = 0; i < num_touches; i++) {
+        phase = (double)i / num_touches * 2 * M_PI;
+        r = 0.1 + 0.3 * i / num_touches;
+        touches[i].id = SESSION_BASE + i;
+        touches[i].x = 0.5 + r * cos(t + phase);
+        touches[i].y = 0.5 + r * sin(t + phase);
+    }
+}
+
+static void
+_fail(const char *scenario, const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "FAIL %s: ", scenario);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    failures++;
+}
+
+/**
+ * Moves the touches of a scenario for its frames, then lifts them.  Every
+ * touch must have been pressed and released once.
+ */
+static void
+_run_scenario(const ScenarioRec *sc)
+{
+    HarnessRec h;
+    StubTouchRec touches[STUB_MAX_TOUCHES];
+    const char *options[] = { "MaxFrameRate", sc->max_frame_rate, NULL };
+    int i;
+
+    if (_harness_open(&h, sc->name, sc->num_touches,
+                      sc->max_frame_rate ? options : NULL)) {
+        for (i = 0; i < sc->frames; i++) {
+            _touches_move(touches, sc->num_touches, i);
+            _frame_send(&h, 0, touches, sc->num_touches, sc->split);
+            _frame_wait(&h);
+        }
+        _frame_send(&h, 0, touches, 0, 0);
+        _frame_wait(&h);
+
+        if (h.downs != sc->num_touches || h.ups != sc->num_touches)
+            _fail(sc->name, "%lu presses and %lu releases of %i touches\n",
+                  h.downs, h.ups, sc->num_touches);
+        if (h.motion < sc->num_touches)
+            _fail(sc->name, "%lu motion events\n", h.motion);
+
+        printf("scenario=%s touches=%i frames=%i split=%i "
+               "max_frame_rate=%s motion=%lu buttons=%lu "
+               "latency_p50_us=%.1f latency_p99_us=%.1f "
+               "latency_p999_us=%.1f\n",
+               sc->name, sc->num_touches, sc->frames, sc->split,
+               sc->max_frame_rate ? sc->max_frame_rate : "0", h.motion,
+               h.downs + h.ups, _latency_percentile(&h, 0.5),
+               _latency_percentile(&h, 0.99), _latency_percentile(&h, 0.999));
+    }
+    _harness_close(&h);
+}
+
+/**
+ * The statistics property must count the packets sent, and stay
+ * read-only for clients
+ */
+static void
+_check_statistics(void)
+{
+    HarnessRec h;
+    StubTouchRec touches[1];
+    CARD32 *stats, before = 0, after = 0;
+    int i;
+
+    if (_harness_open(&h, "statistics", 1, NULL)) {
+        if ((stats = stub_get_property(h.core, TUIO_PROP_STATISTICS, NULL)))
+            before = stats[TUIO_STAT_PACKETS];
+        for (i = 0; i < 10; i++) {
+            _touches_move(touches, 1, i);
+            _frame_send(&h, 0, touches, 1, 0);
+            _frame_wait(&h);
+        }
+        if ((stats = stub_get_property(h.core, TUIO_PROP_STATISTICS, NULL)))
+            after = stats[TUIO_STAT_PACKETS];
+
+        if (stats == NULL)
+            _fail("statistics", "property can't be read\n");
+        else if (after - before != 10)
+            _fail("statistics", "%u packets counted, 10 sent\n",
+                  (unsigned int)(after - before));
+        if (stats && stub_set_property(h.core, TUIO_PROP_STATISTICS,
+                                       XA_INTEGER, 32, TUIO_STAT_COUNT,
+                                       stats) != BadAccess)
+            _fail("statistics", "clients can change the property\n");
+    }
+    _harness_close(&h);
+}
+
+/**
+ * Two trackers send to the same device, each with its own touches and
+ * fseq numbers.  The alive message of one tracker must not release the
+ * touches of the other, and the fseq numbers of one must not make the
+ * frames of the other stale.
+ */
+static void
+_check_trackers(void)
+{
+    HarnessRec h;
+    StubTouchRec touches[2][2];
+    int i, j;
+
+    if (_harness_open(&h, "trackers", 4, NULL)) {
+        h.fseq[0] = 50;
+        for (i = 0; i < 100; i++) {
+            for (j = 0; j < 2; j++) {
+                _touches_move(touches[j], 2, i + j * 100);
+                touches[j][0].id = SESSION_BASE + j * 100;
+                touches[j][1].id = SESSION_BASE + j * 100 + 1;
+                _frame_send(&h, j, touches[j], 2, 0);
+            }
+            _frame_wait(&h);
+        }
+        if (h.downs != 4 || h.ups != 0)
+            _fail("trackers", "%lu presses and %lu releases while the "
+                  "4 touches are down\n", h.downs, h.ups);
+
+        for (j = 0; j < 2; j++)
+            _frame_send(&h, j, touches[j], 0, 0);
+        _frame_wait(&h);
+        if (h.ups != 4)
+            _fail("trackers", "%lu of 4 touches released\n", h.ups);
+    }
+    _harness_close(&h);
+}
+
+/**
+ * Two touches scroll down together, then one is lifted.  The scroll must
+ * be posted as clicks, and the touch left must move in the frame the
+ * other one is lifted in.
+ */
+static void
+_check_gesture(void)
+{
+    HarnessRec h;
+    StubTouchRec touches[2];
+    const char *options[] = { "Gestures", "on", NULL };
+    unsigned long motion;
+    int i;
+
+    if (_harness_open(&h, "gesture", 2, options)) {
+        for (i = 0; i < 30; i++) {
+            touches[0].id = SESSION_BASE;
+            touches[0].x = 0.4;
+            touches[0].y = 0.3 + i * 0.01;
+            touches[1].id = SESSION_BASE + 1;
+            touches[1].x = 0.6;
+            touches[1].y = touches[0].y;
+            _frame_send(&h, 0, touches, 2, 0);
+            _frame_wait(&h);
+        }
+        if (h.clicks == 0)
+            _fail("gesture", "no scroll clicks\n");
+
+        motion = h.motion;
+        touches[0].y += 0.01;
+        _frame_send(&h, 0, touches, 1, 0);
+        _frame_wait(&h);
+        if (h.motion == motion)
+            _fail("gesture", "the touch left doesn't move\n");
+    }
+    _harness_close(&h);
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, c;
+
+    while ((c = getopt(argc, argv, "v")) != -1) {
+        switch (c) {
+            case 'v':
+                stub_verbose = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        _run_scenario(&scenarios[i]);
+    _check_statistics();
+    _check_trackers();
+    _check_gesture();
+
+    if (failures)
+        fprintf(stderr, "%i checks failed\n", failures);
+    return failures ? 1 : 0;
+}
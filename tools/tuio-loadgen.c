@@ -0,0 +1,980 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * tuio-loadgen: synthetic /tuio/2Dcur load generator.
+ *
+ * Sends alive/set/fseq bundles over UDP at a fixed frame rate, optionally
+ * splitting frames across several packets, reordering and dropping packets.
+ * If the name of a tuio core device is given, the driver's statistics
+ * and latency properties are read before and after the run so the
+ * receiver side counters and latency percentiles can be reported.
+ *
+ * In gesture mode two touches stay put and are lifted once a second, so
+ * the driver starts a two finger gesture over and over.  The scroll
+ * clicks the core device posts are counted; any click is a failure, as
+ * the touches never move.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <netinet/tcp.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XInput.h>
+
+#include "tuio-properties.h"
+#include "tuio-ring.h"
+
+#define MIN_TOUCHES 1
+#define MAX_TOUCHES 512
+#define MAX_PACKET 65507
+
+/* OSC timetags count from 1900 */
+#define NTP_EPOCH_OFFSET 2208988800UL
+
+/* Offset of the first session id, so ids don't start at 0 */
+#define SESSION_BASE 1000
+
+typedef struct _Packet {
+    size_t len;
+    char data[MAX_PACKET];
+} PacketRec, *PacketPtr;
+
+typedef struct _LoadGen {
+    const char *host;
+    const char *port;
+    const char *device;
+    const char *iface; /* Interface to send multicast on */
+    const char *transport; /* udp, tcp, unix, unix-stream or shm */
+    int num_touches;
+    double rate;
+    double duration;
+    int split; /* Max number of set messages per packet, 0 = whole frame */
+    int reorder; /* Percent of packets that are swapped with the next one */
+    int loss; /* Percent of packets that are not sent */
+    int machine; /* Machine readable output */
+    int timetag; /* Stamp bundles with the current time */
+    int gesture; /* Stationary two finger gesture check */
+
+    int sock;
+    int stream; /* Packets are sent with a length prefix */
+    TuioRingHeader *ring; /* Ingest ring of the shm transport */
+    int ring_event;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    int32_t fseq;
+    PacketRec held; /* Packet held back for reordering */
+    int have_held;
+
+    /* Counters */
+    unsigned long packets_sent;
+    unsigned long packets_lost;
+    unsigned long packets_reordered;
+    unsigned long frames_sent;
+    unsigned long send_errors;
+    unsigned long scroll_clicks;
+} LoadGenRec, *LoadGenPtr;
+
+/* Driver side counters, see tuio-properties.h */
+typedef struct _DriverStats {
+    unsigned long stats[TUIO_STAT_COUNT];
+    unsigned long latency[TUIO_LATENCY_BUCKETS];
+} DriverStatsRec, *DriverStatsPtr;
+
+/**
+ * Appends an OSC string (NUL terminated, padded to 4 bytes)
+ */
+static char *
+_osc_string(char *p, const char *s)
+{
+    size_t len = strlen(s) + 1;
+
+    memcpy(p, s, len);
+    p += len;
+    while (len++ & 3)
+        *p++ = '\0';
+    return p;
+}
+
+static char *
+_osc_int(char *p, int32_t i)
+{
+    uint32_t n = htonl((uint32_t)i);
+
+    memcpy(p, &n, 4);
+    return p + 4;
+}
+
+static char *
+_osc_float(char *p, float f)
+{
+    uint32_t n;
+
+    memcpy(&n, &f, 4);
+    n = htonl(n);
+    memcpy(p, &n, 4);
+    return p + 4;
+}
+
+/**
+ * Starts a bundle, with the current time as timetag or "immediately"
+ */
+static char *
+_bundle_begin(char *p, int timetag)
+{
+    struct timespec ts;
+
+    p = _osc_string(p, "#bundle");
+    if (!timetag) {
+        p = _osc_int(p, 0);
+        return _osc_int(p, 1);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    p = _osc_int(p, (int32_t)(uint32_t)(ts.tv_sec + NTP_EPOCH_OFFSET));
+    return _osc_int(p, (int32_t)(uint32_t)(((uint64_t)ts.tv_nsec << 32) /
+                                           1000000000));
+}
+
+/**
+ * Appends a bundle element.  The element size is patched in once the
+ * message has been written.
+ */
+static char *
+_element_begin(char *p, char **size)
+{
+    *size = p;
+    return p + 4;
+}
+
+static char *
+_element_end(char *p, char *size)
+{
+    _osc_int(size, (int32_t)(p - size - 4));
+    return p;
+}
+
+static char *
+_msg_alive(char *p, int num_touches)
+{
+    char types[MAX_TOUCHES + 4];
+    char *size;
+    int i;
+
+    types[0] = ',';
+    types[1] = 's';
+    for (i = 0; i < num_touches; i++)
+        types[i + 2] = 'i';
+    types[num_touches + 2] = '\0';
+
+    p = _element_begin(p, &size);
+    p = _osc_string(p, "/tuio/2Dcur");
+    p = _osc_string(p, types);
+    p = _osc_string(p, "alive");
+    for (i = 0; i < num_touches; i++)
+        p = _osc_int(p, SESSION_BASE + i);
+    return _element_end(p, size);
+}
+
+/**
+ * Each touch moves on its own circle around the center of the surface
+ */
+static char *
+_msg_set(char *p, int touch, int num_touches, unsigned long frame,
+         double rate)
+{
+    double phase = (double)touch / num_touches * 2 * M_PI;
+    double t = frame / rate;
+    double r = 0.1 + 0.3 * touch / num_touches;
+    char *size;
+
+    p = _element_begin(p, &size);
+    p = _osc_string(p, "/tuio/2Dcur");
+    p = _osc_string(p, ",sifffff");
+    p = _osc_string(p, "set");
+    p = _osc_int(p, SESSION_BASE + touch);
+    p = _osc_float(p, 0.5 + r * cos(t + phase));
+    p = _osc_float(p, 0.5 + r * sin(t + phase));
+    p = _osc_float(p, -r * sin(t + phase));
+    p = _osc_float(p, r * cos(t + phase));
+    p = _osc_float(p, 0);
+    return _element_end(p, size);
+}
+
+static char *
+_msg_fseq(char *p, int32_t fseq)
+{
+    char *size;
+
+    p = _element_begin(p, &size);
+    p = _osc_string(p, "/tuio/2Dcur");
+    p = _osc_string(p, ",si");
+    p = _osc_string(p, "fseq");
+    p = _osc_int(p, fseq);
+    return _element_end(p, size);
+}
+
+/**
+ * Writes a packet into the ingest ring, following the protocol in
+ * tuio-ring.h
+ */
+static ssize_t
+_ring_send(LoadGenPtr gen, PacketPtr pkt)
+{
+    TuioRingHeader *ring = gen->ring;
+    char *data = (char *)(ring + 1);
+    uint32_t head, tail, off, len = pkt->len, skip = 0;
+    uint32_t wrap = TUIO_RING_WRAP;
+    uint64_t one = 1;
+
+    head = ring->head;
+    tail = ring->tail;
+    __sync_synchronize();
+
+    off = head & (ring->size - 1);
+    if (off + TUIO_RING_RECORD(len) > ring->size)
+        skip = ring->size - off;
+
+    if (skip + TUIO_RING_RECORD(len) > ring->size - (head - tail)) {
+        ring->dropped++;
+        return -1;
+    }
+
+    if (skip) {
+        memcpy(data + off, &wrap, 4);
+        head += skip;
+        off = 0;
+    }
+    memcpy(data + off, &len, 4);
+    memcpy(data + off + 4, pkt->data, len);
+
+    __sync_synchronize();
+    ring->head = head + TUIO_RING_RECORD(len);
+
+    return write(gen->ring_event, &one, sizeof(one));
+}
+
+static void
+_send(LoadGenPtr gen, PacketPtr pkt)
+{
+    struct msghdr msg;
+    struct iovec iov[2];
+    uint32_t size;
+    ssize_t res;
+
+    if (gen->ring) {
+        res = _ring_send(gen, pkt);
+    } else if (!gen->stream) {
+        res = sendto(gen->sock, pkt->data, pkt->len, 0,
+                     (struct sockaddr *)&gen->addr, gen->addrlen);
+    } else {
+        /* Length prefixed, like OSC 1.0 over streams */
+        size = htonl(pkt->len);
+        iov[0].iov_base = &size;
+        iov[0].iov_len = 4;
+        iov[1].iov_base = pkt->data;
+        iov[1].iov_len = pkt->len;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        res = sendmsg(gen->sock, &msg, MSG_NOSIGNAL);
+    }
+
+    if (res < 0)
+        gen->send_errors++;
+    else
+        gen->packets_sent++;
+}
+
+/**
+ * Sends a packet, applying the configured loss and reordering
+ */
+static void
+_emit(LoadGenPtr gen, PacketPtr pkt)
+{
+    if (gen->loss && rand() % 100 < gen->loss) {
+        gen->packets_lost++;
+        return;
+    }
+
+    if (gen->have_held) {
+        _send(gen, pkt);
+        _send(gen, &gen->held);
+        gen->have_held = 0;
+    } else if (gen->reorder && rand() % 100 < gen->reorder) {
+        memcpy(gen->held.data, pkt->data, pkt->len);
+        gen->held.len = pkt->len;
+        gen->have_held = 1;
+        gen->packets_reordered++;
+    } else {
+        _send(gen, pkt);
+    }
+}
+
+/**
+ * Encodes one frame and sends it as one or more bundles.  The first
+ * bundle carries the alive message and the last one the fseq message,
+ * like a tracker that splits a large frame would.
+ */
+static void
+_send_frame(LoadGenPtr gen, unsigned long frame)
+{
+    static PacketRec pkt;
+    int per_packet = gen->split > 0 ? gen->split : gen->num_touches;
+    int num_touches = gen->num_touches;
+    int touch = 0, i;
+    unsigned long cycle;
+    char *p;
+
+    gen->fseq++;
+
+    /* Gesture mode: the touches don't move, and every second there is
+     * a frame without them */
+    if (gen->gesture) {
+        cycle = gen->rate > 2 ? (unsigned long)gen->rate : 2;
+        if (frame % cycle == 0)
+            num_touches = 0;
+        frame = 0;
+    }
+
+    do {
+        p = _bundle_begin(pkt.data, gen->timetag);
+        if (touch == 0)
+            p = _msg_alive(p, num_touches);
+        for (i = 0; i < per_packet && touch < num_touches; i++, touch++)
+            p = _msg_set(p, touch, num_touches, frame, gen->rate);
+        if (touch == num_touches)
+            p = _msg_fseq(p, gen->fseq);
+        pkt.len = p - pkt.data;
+        _emit(gen, &pkt);
+    } while (touch < num_touches);
+
+    gen->frames_sent++;
+}
+
+/**
+ * Reads a 32 bit integer property with count values into values.
+ *
+ * @return 0 if successful, 1 if failure
+ */
+static int
+_read_prop(Display *dpy, XDevice *dev, const char *name, int count,
+           unsigned long *values)
+{
+    Atom prop, type;
+    int format, i;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+
+    prop = XInternAtom(dpy, name, True);
+    if (prop == None ||
+        XGetDeviceProperty(dpy, dev, prop, 0, count, False,
+                           XA_INTEGER, &type, &format, &nitems,
+                           &bytes_after, &data) != Success ||
+        format != 32 || nitems < count) {
+        if (data)
+            XFree(data);
+        return 1;
+    }
+
+    /* 32 bit properties are returned as longs */
+    for (i = 0; i < count; i++)
+        values[i] = (unsigned long)((long *)data)[i] & 0xFFFFFFFF;
+
+    XFree(data);
+    return 0;
+}
+
+/**
+ * Opens the named input device
+ */
+static XDevice *
+_open_device(Display *dpy, const char *name)
+{
+    XDeviceInfo *info;
+    XDevice *dev = NULL;
+    int num, i;
+
+    info = XListInputDevices(dpy, &num);
+    for (i = 0; i < num; i++) {
+        if (strcmp(info[i].name, name) == 0) {
+            dev = XOpenDevice(dpy, info[i].id);
+            break;
+        }
+    }
+    XFreeDeviceList(info);
+
+    if (dev == NULL)
+        fprintf(stderr, "Unable to open device '%s'\n", name);
+    return dev;
+}
+
+/**
+ * Reads the statistics properties of the named device.
+ *
+ * @return 0 if successful, 1 if failure
+ */
+static int
+_read_stats(Display *dpy, const char *name, DriverStatsPtr stats)
+{
+    XDevice *dev;
+    int ret = 0;
+
+    if ((dev = _open_device(dpy, name)) == NULL)
+        return 1;
+
+    if (_read_prop(dpy, dev, TUIO_PROP_STATISTICS, TUIO_STAT_COUNT,
+                   stats->stats) ||
+        _read_prop(dpy, dev, TUIO_PROP_LATENCY, TUIO_LATENCY_BUCKETS,
+                   stats->latency)) {
+        fprintf(stderr, "Device '%s' has no statistics properties\n", name);
+        ret = 1;
+    }
+
+    XCloseDevice(dpy, dev);
+    return ret;
+}
+
+/**
+ * Grabs the named device, so all its button presses come to us.
+ *
+ * @return the button press event type, or -1 if failure
+ */
+static int
+_gesture_grab(Display *dpy, const char *name)
+{
+    XDevice *dev;
+    XEventClass cls;
+    int type;
+
+    if ((dev = _open_device(dpy, name)) == NULL)
+        return -1;
+
+    DeviceButtonPress(dev, type, cls);
+    if (XGrabDevice(dpy, dev, DefaultRootWindow(dpy), False, 1, &cls,
+                    GrabModeAsync, GrabModeAsync, CurrentTime) != Success) {
+        fprintf(stderr, "Unable to grab device '%s'\n", name);
+        XCloseDevice(dpy, dev);
+        return -1;
+    }
+
+    return type;
+}
+
+/**
+ * Counts the scroll clicks (buttons 4-7) received so far
+ */
+static void
+_gesture_count(LoadGenPtr gen, Display *dpy, int press_type)
+{
+    XEvent ev;
+    XDeviceButtonEvent *bev = (XDeviceButtonEvent *)&ev;
+
+    while (XPending(dpy)) {
+        XNextEvent(dpy, &ev);
+        if (ev.type == press_type && bev->button >= 4 && bev->button <= 7)
+            gen->scroll_clicks++;
+    }
+}
+
+/**
+ * Difference of two wrapping 32 bit driver counters
+ */
+#define STAT_DELTA(before, after, i) \
+    (((after)[i] - (before)[i]) & 0xFFFFFFFF)
+
+/**
+ * Returns the lower bound in microseconds of the latency bucket that
+ * holds the given percentile of the frames counted between two reads
+ */
+static unsigned long
+_percentile(DriverStatsPtr before, DriverStatsPtr after, double pct)
+{
+    unsigned long total = 0, sum = 0;
+    int i;
+
+    for (i = 0; i < TUIO_LATENCY_BUCKETS; i++)
+        total += STAT_DELTA(before->latency, after->latency, i);
+
+    for (i = 0; i < TUIO_LATENCY_BUCKETS; i++) {
+        sum += STAT_DELTA(before->latency, after->latency, i);
+        if (total && sum >= total * pct / 100.0)
+            return TUIO_LATENCY_BUCKET_US(i);
+    }
+    return 0;
+}
+
+/**
+ * Prints the results of a run.  If before is NULL, no driver statistics
+ * are available.  In machine readable mode a single line of key=value
+ * pairs is printed, so runs can be collected and compared over time.
+ */
+static void
+_report(LoadGenPtr gen, double elapsed, DriverStatsPtr b, DriverStatsPtr a)
+{
+    unsigned long packets = 0, frames = 0, stale = 0, gaps = 0;
+    unsigned long parse_us = 0, commit_us = 0, allocs = 0, events = 0;
+    unsigned long output = 0, aged = 0, kdrops = 0;
+    unsigned long budget_hits = 0, backlog_drops = 0;
+    unsigned long p50 = 0, p99 = 0, p999 = 0;
+    unsigned long *before = NULL, *after = NULL;
+    double drop = 0;
+
+    if (b) {
+        before = b->stats;
+        after = a->stats;
+        packets = STAT_DELTA(before, after, TUIO_STAT_PACKETS);
+        frames = STAT_DELTA(before, after, TUIO_STAT_FRAMES);
+        stale = STAT_DELTA(before, after, TUIO_STAT_STALE_FRAMES);
+        gaps = STAT_DELTA(before, after, TUIO_STAT_FSEQ_GAPS);
+        kdrops = STAT_DELTA(before, after, TUIO_STAT_KERNEL_DROPS);
+        budget_hits = STAT_DELTA(before, after, TUIO_STAT_BUDGET_HITS);
+        backlog_drops = STAT_DELTA(before, after, TUIO_STAT_BACKLOG_DROPS);
+        parse_us = STAT_DELTA(before, after, TUIO_STAT_PARSE_US);
+        commit_us = STAT_DELTA(before, after, TUIO_STAT_COMMIT_US);
+        allocs = STAT_DELTA(before, after, TUIO_STAT_ALLOCS);
+        events = STAT_DELTA(before, after, TUIO_STAT_EVENTS);
+        output = STAT_DELTA(before, after, TUIO_STAT_OUTPUT_FRAMES);
+        aged = STAT_DELTA(before, after, TUIO_STAT_AGED_FRAMES);
+        p50 = _percentile(b, a, 50);
+        p99 = _percentile(b, a, 99);
+        p999 = _percentile(b, a, 99.9);
+        if (gen->frames_sent)
+            drop = 100.0 * (1.0 - (double)frames / gen->frames_sent);
+    }
+
+    if (gen->machine) {
+        printf("transport=%s touches=%i rate=%.0f split=%i reorder=%i "
+               "loss=%i elapsed=%.3f sent_frames=%lu sent_packets=%lu "
+               "lost_packets=%lu reordered_packets=%lu send_errors=%lu",
+               gen->transport, gen->num_touches, gen->rate, gen->split,
+               gen->reorder, gen->loss, elapsed, gen->frames_sent,
+               gen->packets_sent, gen->packets_lost, gen->packets_reordered,
+               gen->send_errors);
+        if (gen->gesture)
+            printf(" scroll_clicks=%lu", gen->scroll_clicks);
+        if (before)
+            printf(" recv_frames=%lu recv_packets=%lu stale_frames=%lu "
+                   "fseq_gaps=%lu kernel_drops=%lu rcvbuf=%lu budget_hits=%lu "
+                   "backlog_drops=%lu drop_pct=%.2f live_objects=%lu "
+                   "allocs=%lu parse_ns_per_packet=%.0f "
+                   "commit_ns_per_frame=%.0f events=%lu latency_p50_us=%lu "
+                   "latency_p99_us=%lu latency_p999_us=%lu "
+                   "output_frames=%lu in_fps=%.0f out_fps=%.0f "
+                   "aged_frames=%lu frame_age_us=%lu clock_offset_ms=%i "
+                   "clock_drift_ppm=%i",
+                   frames, packets, stale, gaps, kdrops,
+                   after[TUIO_STAT_RCVBUF], budget_hits, backlog_drops, drop,
+                   after[TUIO_STAT_OBJECTS], allocs,
+                   packets ? parse_us * 1000.0 / packets : 0.0,
+                   frames ? commit_us * 1000.0 / frames : 0.0,
+                   events, p50, p99, p999, output,
+                   frames / elapsed, output / elapsed, aged,
+                   after[TUIO_STAT_FRAME_AGE_US],
+                   (int)after[TUIO_STAT_CLOCK_OFFSET_MS],
+                   (int)after[TUIO_STAT_CLOCK_DRIFT_PPM]);
+        printf("\n");
+        return;
+    }
+
+    printf("\n%s, touches %i, split %i, reorder %i%%, loss %i%%\n",
+           gen->transport, gen->num_touches, gen->split, gen->reorder,
+           gen->loss);
+    printf("sent:     %lu frames, %lu packets (%.0f frames/s, "
+           "%.0f packets/s)\n",
+           gen->frames_sent, gen->packets_sent,
+           gen->frames_sent / elapsed, gen->packets_sent / elapsed);
+    printf("          %lu lost, %lu reordered, %lu send errors\n",
+           gen->packets_lost, gen->packets_reordered, gen->send_errors);
+    if (gen->gesture)
+        printf("gesture:  %lu scroll clicks, expected none\n",
+               gen->scroll_clicks);
+
+    if (!before)
+        return;
+
+    printf("received: %lu frames, %lu packets\n", frames, packets);
+    printf("          %lu stale frames, %lu fseq gaps\n", stale, gaps);
+    printf("          %lu packets dropped by the kernel (%lu byte buffer)\n",
+           kdrops, after[TUIO_STAT_RCVBUF]);
+    printf("          %lu reads over budget, %lu backlog packets discarded\n",
+           budget_hits, backlog_drops);
+    printf("          %.2f%% frames dropped\n", drop);
+    printf("driver:   %lu live objects, %lu objects allocated\n",
+           after[TUIO_STAT_OBJECTS], allocs);
+    printf("          %.0f ns/packet decode, %.0f ns/frame commit\n",
+           packets ? parse_us * 1000.0 / packets : 0.0,
+           frames ? commit_us * 1000.0 / frames : 0.0);
+    printf("          %lu events posted\n", events);
+    printf("          %.0f frames/s in, %.0f frames/s out\n",
+           frames / elapsed, output / elapsed);
+    printf("          %lu frames too old, last frame age %lu us\n",
+           aged, after[TUIO_STAT_FRAME_AGE_US]);
+    printf("          tracker clock offset %i ms, drift %i ppm\n",
+           (int)after[TUIO_STAT_CLOCK_OFFSET_MS],
+           (int)after[TUIO_STAT_CLOCK_DRIFT_PPM]);
+    printf("latency:  p50 %lu us, p99 %lu us, p99.9 %lu us\n",
+           p50, p99, p999);
+}
+
+static double
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Sets up sending to a multicast group.  Looped back copies are kept on,
+ * so a driver on the same host receives the stream, and packets don't
+ * leave the local network.
+ */
+static int
+_multicast_setup(LoadGenPtr gen)
+{
+    struct ip_mreqn mreq;
+    int ttl = 1, loop = 1;
+
+    setsockopt(gen->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(gen->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    if (gen->iface == NULL)
+        return 0;
+
+    memset(&mreq, 0, sizeof(mreq));
+    if ((mreq.imr_ifindex = if_nametoindex(gen->iface)) == 0) {
+        fprintf(stderr, "Unknown interface %s\n", gen->iface);
+        return -1;
+    }
+    if (setsockopt(gen->sock, IPPROTO_IP, IP_MULTICAST_IF,
+                   &mreq, sizeof(mreq)) < 0) {
+        perror("IP_MULTICAST_IF");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Receives the ingest ring and its eventfd from the driver listening on
+ * the connected socket, then closes it.
+ */
+static int
+_ring_setup(LoadGenPtr gen)
+{
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    int fds[2];
+    char byte;
+    void *map;
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(gen->sock, &msg, 0) != 1 ||
+        (cmsg = CMSG_FIRSTHDR(&msg)) == NULL ||
+        cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        fprintf(stderr, "No ingest ring received from %s\n", gen->host);
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    close(gen->sock);
+    gen->sock = -1;
+
+    map = mmap(NULL, sizeof(TuioRingHeader) + TUIO_RING_SIZE,
+               PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    gen->ring = map;
+    gen->ring_event = fds[1];
+    if (gen->ring->magic != TUIO_RING_MAGIC ||
+        gen->ring->version != TUIO_RING_VERSION ||
+        gen->ring->size != TUIO_RING_SIZE) {
+        fprintf(stderr, "Unsupported ingest ring\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Opens the socket for the transport.  Stream transports are connected
+ * here, so the driver must be listening already.
+ */
+static int
+_connect(LoadGenPtr gen)
+{
+    struct addrinfo hints, *res;
+    struct sockaddr_un *sun = (struct sockaddr_un *)&gen->addr;
+    struct sockaddr_in *sin = (struct sockaddr_in *)&gen->addr;
+    int type, on = 1;
+
+    if (strcmp(gen->transport, "udp") == 0 ||
+        strcmp(gen->transport, "tcp") == 0) {
+        gen->stream = strcmp(gen->transport, "tcp") == 0;
+        type = gen->stream ? SOCK_STREAM : SOCK_DGRAM;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = type;
+        if (getaddrinfo(gen->host, gen->port, &hints, &res) != 0) {
+            fprintf(stderr, "Unable to resolve %s:%s\n",
+                    gen->host, gen->port);
+            return -1;
+        }
+        memcpy(&gen->addr, res->ai_addr, res->ai_addrlen);
+        gen->addrlen = res->ai_addrlen;
+        gen->sock = socket(res->ai_family, type, 0);
+        freeaddrinfo(res);
+    } else if (strcmp(gen->transport, "unix") == 0 ||
+               strcmp(gen->transport, "unix-stream") == 0 ||
+               strcmp(gen->transport, "shm") == 0) {
+        gen->stream = strcmp(gen->transport, "unix") != 0;
+        type = gen->stream ? SOCK_STREAM : SOCK_DGRAM;
+
+        if (strlen(gen->host) >= sizeof(sun->sun_path)) {
+            fprintf(stderr, "Socket path %s too long\n", gen->host);
+            return -1;
+        }
+        memset(sun, 0, sizeof(*sun));
+        sun->sun_family = AF_UNIX;
+        strcpy(sun->sun_path, gen->host);
+        gen->addrlen = sizeof(*sun);
+        gen->sock = socket(AF_UNIX, type, 0);
+    } else {
+        fprintf(stderr, "Unknown transport %s\n", gen->transport);
+        return -1;
+    }
+
+    if (gen->sock < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    if (gen->stream) {
+        if (connect(gen->sock, (struct sockaddr *)&gen->addr,
+                    gen->addrlen) < 0) {
+            perror("connect");
+            return -1;
+        }
+        if (strcmp(gen->transport, "tcp") == 0)
+            setsockopt(gen->sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if (strcmp(gen->transport, "shm") == 0)
+            return _ring_setup(gen);
+    }
+
+    if (!gen->stream && gen->addr.ss_family == AF_INET &&
+        IN_MULTICAST(ntohl(sin->sin_addr.s_addr)))
+        return _multicast_setup(gen);
+
+    return 0;
+}
+
+static void
+_usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -h host      destination host (default 127.0.0.1)\n"
+            "  -p port      destination UDP port (default 3333)\n"
+            "  -n touches   number of touches, %i-%i (default 1)\n"
+            "  -r rate      frames per second (default 60)\n"
+            "  -t seconds   duration of the run (default 10)\n"
+            "  -s sets      max set messages per packet, 0 = whole frame\n"
+            "  -o percent   packets swapped with the following packet\n"
+            "  -l percent   packets dropped before sending\n"
+            "  -x transport udp, tcp, unix, unix-stream or shm (default udp);\n"
+            "               for unix, unix-stream and shm host is the socket path\n"
+            "  -i iface     interface to send to a multicast host on\n"
+            "  -d device    tuio core device to read statistics from; fails\n"
+            "               if they don't change while packets are sent\n"
+            "  -T           stamp bundles with the current time\n"
+            "  -g           two finger gesture check, needs -d; fails if the\n"
+            "               stationary touches cause scroll clicks\n"
+            "  -m           machine readable output\n",
+            argv0, MIN_TOUCHES, MAX_TOUCHES);
+}
+
+int
+main(int argc, char **argv)
+{
+    LoadGenRec gen;
+    struct timespec next;
+    Display *dpy = NULL;
+    DriverStatsRec before, after;
+    unsigned long frame = 0, last_packets = 0, last_frames = 0;
+    double start, last, now, elapsed;
+    long period;
+    int opt, have_stats = 0, stale_stats = 0, press_type = -1;
+
+    memset(&gen, 0, sizeof(gen));
+    gen.host = "127.0.0.1";
+    gen.port = "3333";
+    gen.num_touches = 1;
+    gen.rate = 60;
+    gen.duration = 10;
+    gen.transport = "udp";
+
+    while ((opt = getopt(argc, argv, "h:p:n:r:t:s:o:l:x:i:d:mTg")) != -1) {
+        switch (opt) {
+            case 'h': gen.host = optarg; break;
+            case 'p': gen.port = optarg; break;
+            case 'n': gen.num_touches = atoi(optarg); break;
+            case 'r': gen.rate = atof(optarg); break;
+            case 't': gen.duration = atof(optarg); break;
+            case 's': gen.split = atoi(optarg); break;
+            case 'o': gen.reorder = atoi(optarg); break;
+            case 'l': gen.loss = atoi(optarg); break;
+            case 'x': gen.transport = optarg; break;
+            case 'i': gen.iface = optarg; break;
+            case 'd': gen.device = optarg; break;
+            case 'm': gen.machine = 1; break;
+            case 'T': gen.timetag = 1; break;
+            case 'g': gen.gesture = 1; break;
+            default:
+                _usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (gen.num_touches < MIN_TOUCHES || gen.num_touches > MAX_TOUCHES ||
+        gen.rate <= 0 || gen.duration <= 0 || gen.split < 0 ||
+        (gen.gesture && gen.device == NULL)) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    /* A gesture needs exactly two touches */
+    if (gen.gesture)
+        gen.num_touches = 2;
+
+    if (_connect(&gen) != 0)
+        return 1;
+
+    if (gen.device) {
+        if ((dpy = XOpenDisplay(NULL)) == NULL) {
+            fprintf(stderr, "Unable to open display\n");
+            return 1;
+        }
+        have_stats = _read_stats(dpy, gen.device, &before) == 0;
+        if (gen.gesture &&
+            (press_type = _gesture_grab(dpy, gen.device)) < 0)
+            return 1;
+    }
+
+    period = (long)(1e9 / gen.rate);
+    start = last = _now();
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while ((now = _now()) - start < gen.duration) {
+        _send_frame(&gen, frame++);
+        if (gen.gesture)
+            _gesture_count(&gen, dpy, press_type);
+
+        if (!gen.machine && now - last >= 1.0) {
+            printf("%8.0f packets/s %8.0f frames/s\n",
+                   (gen.packets_sent - last_packets) / (now - last),
+                   (gen.frames_sent - last_frames) / (now - last));
+            fflush(stdout);
+            last_packets = gen.packets_sent;
+            last_frames = gen.frames_sent;
+            last = now;
+        }
+
+        next.tv_nsec += period;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    elapsed = _now() - start;
+
+    if (gen.have_held)
+        _send(&gen, &gen.held);
+
+    /* Give the driver a moment to drain its socket */
+    usleep(200000);
+    if (gen.gesture) {
+        XSync(dpy, False);
+        _gesture_count(&gen, dpy, press_type);
+    }
+
+    if (have_stats)
+        have_stats = _read_stats(dpy, gen.device, &after) == 0;
+    _report(&gen, elapsed, have_stats ? &before : NULL, &after);
+
+    /* The driver refreshes its statistics when they are read, so packets
+     * it received must show up in them */
+    if (have_stats && gen.packets_sent &&
+        STAT_DELTA(before.stats, after.stats, TUIO_STAT_PACKETS) == 0) {
+        fprintf(stderr, "Statistics of device '%s' didn't change\n",
+                gen.device);
+        stale_stats = 1;
+    }
+
+    if (dpy)
+        XCloseDisplay(dpy);
+    if (gen.sock >= 0)
+        close(gen.sock);
+
+    return gen.scroll_clicks || stale_stats ? 1 : 0;
+}
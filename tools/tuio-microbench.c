@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * tuio-microbench: times the object table operations of the driver, built
+ * against the stub server of tuio-stubs.c like tuio-harness.
+ *
+ * For 1, 10, 50 and 500 live objects it reports the time per operation
+ * of looking up an object by session id, removing one and inserting it
+ * again, decoding a frame with a set message for every object, and
+ * committing a frame in which every object moved.  Each line is machine
+ * readable:
+ *
+ *   objects=50 op=lookup iterations=N ns_per_op=X allocs_per_op=Y
+ *
+ * with cache_misses_per_op=Z added where the kernel has a cache miss
+ * counter for us.
+ */
+
+/* See tuio-harness.c */
+#undef HAVE_CONFIG_H
+#include "tuio.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "tuio-stubs.h"
+
+#define BATCH 256 /* Operations between looks at the clock */
+#define NUM_RANDOM 1024 /* Random object indices, a power of two */
+#define SESSION_BASE 1000 /* Offset of the first session id */
+
+static const int sweep[] = { 1, 10, 50, 500 };
+
+typedef struct _Bench {
+    InputInfoPtr pInfo; /* Core device of decode and commit */
+    ObjectPtr list; /* Object table of lookup and insert_remove */
+    int num_objects;
+    int random[NUM_RANDOM];
+    int next; /* Next random index */
+    char frame[TUIO_MAX_PACKET];
+    int frame_len;
+    int32_t fseq; /* fseq of the last frame committed by _device_fill() */
+    unsigned long found; /* So lookups aren't optimized out */
+} BenchRec, *BenchPtr;
+
+typedef void (*BenchOp)(BenchPtr b, int count);
+
+static int64_t duration = 200000000; /* ns each operation is timed for */
+static int cache_fd = -1;
+
+static void _op_lookup(BenchPtr b, int count);
+static void _op_insert_remove(BenchPtr b, int count);
+static void _op_decode(BenchPtr b, int count);
+static void _op_commit(BenchPtr b, int count);
+static void _table_fill(BenchPtr b, int num_objects);
+static void _table_free(BenchPtr b);
+static void _device_fill(BenchPtr b, int num_objects);
+static void _run(BenchPtr b, const char *name, BenchOp op, int batch);
+static void _cache_open(void);
+static long long _cache_read(void);
+
+static void
+_op_lookup(BenchPtr b, int count)
+{
+    while (count--) {
+        if (_object_get(b->list, SESSION_BASE + b->random[b->next]))
+            b->found++;
+        b->next = (b->next + 1) & (NUM_RANDOM - 1);
+    }
+}
+
+/**
+ * Takes an object out of the table and puts a new one in its place, like
+ * a touch that is lifted while another one comes down
+ */
+static void
+_op_insert_remove(BenchPtr b, int count)
+{
+    ObjectPtr obj;
+    int id;
+
+    while (count--) {
+        id = SESSION_BASE + b->random[b->next];
+        b->next = (b->next + 1) & (NUM_RANDOM - 1);
+        xfree(_object_remove(&b->list, id));
+        obj = _object_new(id);
+        _object_add(&b->list, obj);
+    }
+}
+
+/**
+ * Decodes a packet with the alive message and the set messages of a
+ * frame, but no fseq message, so it isn't committed
+ */
+static void
+_op_decode(BenchPtr b, int count)
+{
+    while (count--)
+        _tuio_packet(b->pInfo, b->frame, b->frame_len, 0, 0);
+}
+
+/**
+ * Commits a frame in which every object moved
+ */
+static void
+_op_commit(BenchPtr b, int count)
+{
+    TuioDevicePtr pTuio = b->pInfo->private;
+    ObjectPtr obj;
+
+    while (count--) {
+        for (obj = pTuio->obj_list; obj != NULL; obj = obj->next)
+            obj->pending.set = True;
+        _frame_commit(b->pInfo);
+        stub_events_clear();
+    }
+}
+
+/**
+ * Fills the object table of lookup and insert_remove
+ */
+static void
+_table_fill(BenchPtr b, int num_objects)
+{
+    int i;
+
+    _table_free(b);
+    for (i = 0; i < num_objects; i++)
+        _object_add(&b->list, _object_new(SESSION_BASE + i));
+    for (i = 0; i < NUM_RANDOM; i++)
+        b->random[i] = random() % num_objects;
+    b->num_objects = num_objects;
+}
+
+static void
+_table_free(BenchPtr b)
+{
+    ObjectPtr obj;
+
+    while ((obj = b->list) != NULL) {
+        b->list = obj->next;
+        xfree(obj);
+    }
+}
+
+/**
+ * Brings the objects of the core device to num_objects, each with a
+ * subdevice, and writes the frame _op_decode() decodes
+ */
+static void
+_device_fill(BenchPtr b, int num_objects)
+{
+    StubTouchRec touches[STUB_MAX_TOUCHES];
+    char buf[TUIO_MAX_PACKET];
+    int i, len;
+
+    for (i = 0; i < num_objects; i++) {
+        touches[i].id = SESSION_BASE + i;
+        touches[i].x = (float)(i + 1) / (num_objects + 1);
+        touches[i].y = 0.5;
+    }
+
+    /* Release the objects of the previous run, then commit a frame with
+     * the new ones */
+    len = stub_frame(buf, touches, 0, 0, 0, STUB_ALIVE | STUB_FSEQ,
+                     ++b->fseq);
+    _tuio_packet(b->pInfo, buf, len, 0, 0);
+    len = stub_frame(buf, touches, num_objects, 0, num_objects,
+                     STUB_ALIVE | STUB_FSEQ, ++b->fseq);
+    _tuio_packet(b->pInfo, buf, len, 0, 0);
+    stub_events_clear();
+
+    b->frame_len = stub_frame(b->frame, touches, num_objects, 0, num_objects,
+                              STUB_ALIVE, 0);
+}
+
+/**
+ * Times an operation for the configured duration, in batches of batch
+ * operations, and prints the result
+ */
+static void
+_run(BenchPtr b, const char *name, BenchOp op, int batch)
+{
+    unsigned long iterations = 0, allocs;
+    long long misses;
+    int64_t start, elapsed;
+
+    op(b, batch); /* Warm up */
+
+    allocs = stub_allocs;
+    misses = _cache_read();
+    start = stub_now();
+    do {
+        op(b, batch);
+        iterations += batch;
+        elapsed = stub_now() - start;
+    } while (elapsed < duration);
+
+    printf("objects=%i op=%s iterations=%lu ns_per_op=%.1f "
+           "allocs_per_op=%.2f", b->num_objects, name, iterations,
+           (double)elapsed / iterations,
+           (double)(stub_allocs - allocs) / iterations);
+    if (misses >= 0)
+        printf(" cache_misses_per_op=%.2f",
+               (double)(_cache_read() - misses) / iterations);
+    printf("\n");
+}
+
+/**
+ * Opens the cache miss counter of this process, if the kernel lets us
+ */
+static void
+_cache_open(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cache_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+/**
+ * @return the cache misses so far, or -1 without a counter
+ */
+static long long
+_cache_read(void)
+{
+    long long count;
+
+    if (cache_fd == -1 || read(cache_fd, &count, sizeof(count)) !=
+                          sizeof(count))
+        return -1;
+    return count;
+}
+
+int
+main(int argc, char **argv)
+{
+    static BenchRec bench;
+    const char *options[] = { "Port", "0", "PseudoHide", "off", NULL };
+    const char *sub_options[] = { "Type", "Object", "Core", "microbench",
+                                  NULL };
+    DeviceIntPtr core, subdev;
+    char name[64];
+    int i, c, max_objects = sweep[sizeof(sweep) / sizeof(sweep[0]) - 1];
+
+    while ((c = getopt(argc, argv, "t:v")) != -1) {
+        switch (c) {
+            case 't':
+                duration = (int64_t)(atof(optarg) * 1000000);
+                break;
+            case 'v':
+                stub_verbose = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t ms per operation] [-v]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    /* Every object gets a subdevice, the core device is one of them */
+    if (!(core = stub_device_new("microbench", options)) ||
+        !EnableDevice(core, TRUE)) {
+        fprintf(stderr, "Can't create the core device\n");
+        return 1;
+    }
+    for (i = 1; i < max_objects; i++) {
+        snprintf(name, sizeof(name), "microbench subdev %i", i);
+        if (!(subdev = stub_device_new(name, sub_options)) ||
+            !EnableDevice(subdev, TRUE)) {
+            fprintf(stderr, "Can't create subdevice %i\n", i);
+            return 1;
+        }
+    }
+    bench.pInfo = core->public.devicePrivate;
+
+    _cache_open();
+    srandom(1);
+    for (i = 0; i < sizeof(sweep) / sizeof(sweep[0]); i++) {
+        _table_fill(&bench, sweep[i]);
+        _run(&bench, "lookup", _op_lookup, BATCH);
+        _run(&bench, "insert_remove", _op_insert_remove, BATCH);
+        _device_fill(&bench, sweep[i]);
+        _run(&bench, "decode", _op_decode, 1);
+        _run(&bench, "commit", _op_commit, 1);
+    }
+    _table_free(&bench);
+
+    return 0;
+}
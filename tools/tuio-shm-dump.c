@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * tuio-shm-dump: prints the frames a tuio core device publishes in shared
+ * memory (Option "SharedMemory"), as a reference reader of the seqlock
+ * protocol described in tuio-shm.h.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "tuio-shm.h"
+
+/**
+ * Copies the latest frame.  Returns the number of the frame, or 0 if
+ * nothing has been published yet.
+ */
+static uint32_t
+_read_latest(volatile TuioShmHeader *shm, TuioShmFrame *copy)
+{
+    volatile TuioShmFrame *frame;
+    uint32_t head, seq;
+
+    for (;;) {
+        head = shm->head;
+        if (head == 0)
+            return 0;
+
+        frame = &shm->frames[(head - 1) % TUIO_SHM_SLOTS];
+        seq = frame->seq;
+        if (seq & 1)
+            continue; /* Being written */
+        __sync_synchronize();
+
+        memcpy(copy, (const void *)frame, sizeof(*copy));
+
+        __sync_synchronize();
+        if (frame->seq == seq)
+            return copy->frame;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    volatile TuioShmHeader *shm;
+    TuioShmFrame frame;
+    uint32_t last = 0, i;
+    char path[256];
+    int fd;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s name\n", argv[0]);
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), TUIO_SHM_PREFIX "%s", argv[1]);
+    if ((fd = shm_open(path, O_RDONLY, 0)) == -1) {
+        perror(path);
+        return 1;
+    }
+    shm = mmap(NULL, sizeof(TuioShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    if (shm->magic != TUIO_SHM_MAGIC || shm->version != TUIO_SHM_VERSION) {
+        fprintf(stderr, "%s: not a version %i TUIO frame export\n",
+                path, TUIO_SHM_VERSION);
+        return 1;
+    }
+
+    for (;;) {
+        if (_read_latest(shm, &frame) == last || frame.frame == 0) {
+            usleep(1000);
+            continue;
+        }
+
+        if (last && frame.frame != last + 1)
+            printf("skipped %u frames\n", frame.frame - last - 1);
+        last = frame.frame;
+
+        printf("frame %u fseq %i time %lld us, %u objects\n",
+               frame.frame, frame.fseq, (long long)frame.time_us,
+               frame.num_objects);
+        for (i = 0; i < frame.num_objects && i < TUIO_SHM_MAX_OBJECTS; i++)
+            printf("  %i: %.4f %.4f (%.4f %.4f)\n", frame.objects[i].id,
+                   frame.objects[i].x, frame.objects[i].y,
+                   frame.objects[i].xvel, frame.objects[i].yvel);
+        fflush(stdout);
+    }
+
+    return 0;
+}
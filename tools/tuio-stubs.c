@@ -0,0 +1,961 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * The stub X server of the test programs, see tuio-stubs.h.  There are
+ * no clients, no event queue and no SIGIO: the test programs read input
+ * with stub_wait() and run the main loop with stub_run().  The events the
+ * driver posts are logged in stub_events.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <arpa/inet.h>
+#include <dbus/dbus.h>
+
+#include "tuio-stubs.h"
+
+/* A property set with XIChangeDeviceProperty() */
+typedef struct _StubProperty {
+    struct _StubProperty *next;
+    Atom name;
+    XIPropertyValueRec value;
+} StubPropertyRec, *StubPropertyPtr;
+
+struct _OsTimerRec {
+    struct _OsTimerRec *next;
+    Bool armed;
+    CARD32 expires;
+    OsTimerCallback callback;
+    pointer arg;
+};
+
+/* A work procedure queued with QueueWorkProc() */
+typedef struct _StubWork {
+    struct _StubWork *next;
+    Bool (*function)(ClientPtr client, pointer closure);
+    ClientPtr client;
+    pointer closure;
+} StubWorkRec, *StubWorkPtr;
+
+extern XF86ModuleData tuioModuleData;
+
+StubEventRec stub_events[STUB_MAX_EVENTS];
+int stub_num_events;
+unsigned long stub_allocs;
+int stub_verbose;
+
+InputInfoPtr xf86InputDevs;
+
+static InputDriverPtr stub_driver;
+static OsTimerPtr stub_timers;
+static StubWorkPtr stub_work;
+static char **stub_atoms;
+static int stub_num_atoms;
+static int stub_next_id = 2; /* 0 and 1 are the virtual core devices */
+
+static void _work_append(StubWorkPtr work);
+static StubPropertyPtr _property_find(DeviceIntPtr dev, Atom name);
+static const char *_option_find(pointer optlist, const char *name);
+static StubEventPtr _event_new(DeviceIntPtr dev, int type);
+static char *_osc_string(char *p, const char *s);
+static char *_osc_int(char *p, int32_t i);
+static char *_osc_float(char *p, float f);
+
+/**
+ * Current time in ns, from the same clock as GetTimeInMillis()
+ */
+int64_t
+stub_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+stub_events_clear(void)
+{
+    stub_num_events = 0;
+}
+
+/**
+ * Loads the driver like the module loader does
+ */
+Bool
+stub_load_driver(void)
+{
+    int errmaj = 0, errmin = 0;
+
+    if (stub_driver == NULL)
+        tuioModuleData.setup(NULL, NULL, &errmaj, &errmin);
+    return stub_driver != NULL;
+}
+
+/**
+ * Creates and initializes a tuio device, like the server does for an
+ * InputDevice section or a HAL device.  The device is not enabled.
+ *
+ * @param options NULL terminated list of option name and value pairs
+ */
+DeviceIntPtr
+stub_device_new(const char *name, const char **options)
+{
+    IDevPtr idev;
+    InputInfoPtr pInfo;
+    DeviceIntPtr dev;
+
+    if (!stub_load_driver())
+        return NULL;
+
+    if (!(idev = calloc(1, sizeof(IDevRec))))
+        return NULL;
+    idev->identifier = strdup(name);
+    idev->driver = "tuio";
+    idev->commonOptions = (pointer)options;
+
+    pInfo = stub_driver->PreInit(stub_driver, idev, 0);
+    if (pInfo == NULL || !(dev = calloc(1, sizeof(DeviceIntRec)))) {
+        if (pInfo)
+            stub_driver->UnInit(stub_driver, pInfo, 0);
+        free(idev->identifier);
+        free(idev);
+        return NULL;
+    }
+
+    dev->id = stub_next_id++;
+    dev->name = pInfo->name;
+    dev->public.devicePrivate = pInfo;
+    dev->deviceProc = pInfo->device_control;
+    pInfo->dev = dev;
+
+    if (dev->deviceProc(dev, DEVICE_INIT) != Success) {
+        stub_device_free(dev);
+        return NULL;
+    }
+    return dev;
+}
+
+/**
+ * Disables, closes and removes a device
+ */
+void
+stub_device_free(DeviceIntPtr dev)
+{
+    InputInfoPtr pInfo = dev->public.devicePrivate;
+    IDevPtr idev = pInfo->conf_idev;
+    StubPropertyPtr prop;
+
+    DisableDevice(dev, FALSE);
+    dev->deviceProc(dev, DEVICE_CLOSE);
+    stub_driver->UnInit(stub_driver, pInfo, 0);
+
+    while ((prop = dev->properties) != NULL) {
+        dev->properties = prop->next;
+        free(prop->value.data);
+        free(prop);
+    }
+    free(dev->valuator);
+    free(dev);
+    free(idev->identifier);
+    free(idev);
+}
+
+/**
+ * One iteration of the main loop: runs the timers that are due, then the
+ * queued work procedures
+ */
+void
+stub_run(void)
+{
+    OsTimerPtr timer;
+    StubWorkPtr work, list;
+    CARD32 now, next;
+
+    /* Callbacks may set and free timers, so the list is searched again
+     * after each one */
+    do {
+        now = GetTimeInMillis();
+        for (timer = stub_timers; timer != NULL; timer = timer->next)
+            if (timer->armed && (int)(now - timer->expires) >= 0)
+                break;
+        if (timer) {
+            timer->armed = FALSE;
+            next = timer->callback(timer, now, timer->arg);
+            if (next) {
+                timer->armed = TRUE;
+                timer->expires = now + next;
+            }
+        }
+    } while (timer);
+
+    /* Work procedures stay queued until they return TRUE */
+    list = stub_work;
+    stub_work = NULL;
+    while ((work = list) != NULL) {
+        list = work->next;
+        if (work->function(work->client, work->closure))
+            free(work);
+        else
+            _work_append(work);
+    }
+}
+
+/**
+ * Runs the main loop until the given time (see stub_now()).  The device
+ * is read whenever its socket is ready, as the SIGIO handler would.
+ */
+void
+stub_wait(InputInfoPtr pInfo, int64_t until)
+{
+    int64_t left;
+
+    do {
+        left = (until - stub_now()) / 1000;
+        if (left < 0)
+            left = 0;
+        else if (left > 1000)
+            left = 1000; /* Timers are run at least once a ms */
+        if (xf86WaitForInput(pInfo->fd, left) > 0)
+            pInfo->read_input(pInfo);
+        stub_run();
+    } while (stub_now() < until);
+}
+
+/**
+ * Reads a device property like a client does: the property handler of
+ * the driver may update it first.
+ *
+ * @return the data of the property, or NULL if there is none
+ */
+pointer
+stub_get_property(DeviceIntPtr dev, const char *name, long *size)
+{
+    Atom atom = MakeAtom(name, strlen(name), FALSE);
+    StubPropertyPtr prop;
+
+    if (atom == None)
+        return NULL;
+    if (dev->get_property && dev->get_property(dev, atom) != Success)
+        return NULL;
+    if (!(prop = _property_find(dev, atom)))
+        return NULL;
+
+    if (size)
+        *size = prop->value.size;
+    return prop->value.data;
+}
+
+/**
+ * Changes a device property like a client does
+ *
+ * @return the status the client would get
+ */
+int
+stub_set_property(DeviceIntPtr dev, const char *name, Atom type, int format,
+                  long size, pointer data)
+{
+    return XIChangeDeviceProperty(dev, MakeAtom(name, strlen(name), TRUE),
+                                  type, format, PropModeReplace, size, data,
+                                  FALSE);
+}
+
+/**
+ * Writes a /tuio/2Dcur bundle to be sent to the driver.  The bundle has
+ * an alive message with all touches if flags has STUB_ALIVE, set messages
+ * for num_set touches from first, and an fseq message if flags has
+ * STUB_FSEQ.
+ *
+ * @return the length of the bundle
+ */
+int
+stub_frame(char *buf, const StubTouchRec *touches, int num_touches,
+           int first, int num_set, int flags, int32_t fseq)
+{
+    char types[STUB_MAX_TOUCHES + 3];
+    char *p = buf, *size;
+    int i;
+
+    if (num_touches > STUB_MAX_TOUCHES)
+        num_touches = STUB_MAX_TOUCHES;
+
+    p = _osc_string(p, "#bundle");
+    p = _osc_int(p, 0);
+    p = _osc_int(p, 1); /* Immediately */
+
+    if (flags & STUB_ALIVE) {
+        types[0] = ',';
+        types[1] = 's';
+        for (i = 0; i < num_touches; i++)
+            types[i + 2] = 'i';
+        types[num_touches + 2] = '\0';
+
+        size = p;
+        p = _osc_string(p + 4, "/tuio/2Dcur");
+        p = _osc_string(p, types);
+        p = _osc_string(p, "alive");
+        for (i = 0; i < num_touches; i++)
+            p = _osc_int(p, touches[i].id);
+        _osc_int(size, p - size - 4);
+    }
+
+    for (i = first; i < first + num_set && i < num_touches; i++) {
+        size = p;
+        p = _osc_string(p + 4, "/tuio/2Dcur");
+        p = _osc_string(p, ",sifffff");
+        p = _osc_string(p, "set");
+        p = _osc_int(p, touches[i].id);
+        p = _osc_float(p, touches[i].x);
+        p = _osc_float(p, touches[i].y);
+        p = _osc_float(p, 0);
+        p = _osc_float(p, 0);
+        p = _osc_float(p, 0);
+        _osc_int(size, p - size - 4);
+    }
+
+    if (flags & STUB_FSEQ) {
+        size = p;
+        p = _osc_string(p + 4, "/tuio/2Dcur");
+        p = _osc_string(p, ",si");
+        p = _osc_string(p, "fseq");
+        p = _osc_int(p, fseq);
+        _osc_int(size, p - size - 4);
+    }
+
+    return p - buf;
+}
+
+/**
+ * Appends an OSC string (NUL terminated, padded to 4 bytes)
+ */
+static char *
+_osc_string(char *p, const char *s)
+{
+    size_t len = strlen(s) + 1;
+
+    memcpy(p, s, len);
+    p += len;
+    while (len++ & 3)
+        *p++ = '\0';
+    return p;
+}
+
+static char *
+_osc_int(char *p, int32_t i)
+{
+    uint32_t n = htonl((uint32_t)i);
+
+    memcpy(p, &n, 4);
+    return p + 4;
+}
+
+static char *
+_osc_float(char *p, float f)
+{
+    uint32_t n;
+
+    memcpy(&n, &f, 4);
+    n = htonl(n);
+    memcpy(p, &n, 4);
+    return p + 4;
+}
+
+/* Logging */
+
+void
+xf86Msg(MessageType type, const char *format, ...)
+{
+    va_list args;
+
+    if (!stub_verbose)
+        return;
+
+    if (type == X_ERROR)
+        fputs("(EE) ", stderr);
+    else if (type == X_WARNING)
+        fputs("(WW) ", stderr);
+    else if (type == X_INFO)
+        fputs("(II) ", stderr);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+/* Memory */
+
+pointer
+xalloc(unsigned long size)
+{
+    stub_allocs++;
+    return malloc(size);
+}
+
+pointer
+xcalloc(unsigned long num, unsigned long size)
+{
+    stub_allocs++;
+    return calloc(num, size);
+}
+
+pointer
+xrealloc(pointer ptr, unsigned long size)
+{
+    stub_allocs++;
+    return realloc(ptr, size);
+}
+
+void
+xfree(pointer ptr)
+{
+    free(ptr);
+}
+
+char *
+xstrdup(const char *s)
+{
+    if (s == NULL)
+        return NULL;
+    stub_allocs++;
+    return strdup(s);
+}
+
+/* Timers and work procedures */
+
+OsTimerPtr
+TimerSet(OsTimerPtr timer, int flags, CARD32 millis, OsTimerCallback func,
+         pointer arg)
+{
+    if (timer == NULL) {
+        if (!(timer = calloc(1, sizeof(struct _OsTimerRec))))
+            return NULL;
+        timer->next = stub_timers;
+        stub_timers = timer;
+    }
+
+    timer->callback = func;
+    timer->arg = arg;
+    timer->expires = GetTimeInMillis() + millis;
+    timer->armed = millis != 0;
+    return timer;
+}
+
+void
+TimerCancel(OsTimerPtr timer)
+{
+    if (timer)
+        timer->armed = FALSE;
+}
+
+void
+TimerFree(OsTimerPtr timer)
+{
+    OsTimerPtr *prev;
+
+    if (timer == NULL)
+        return;
+
+    for (prev = &stub_timers; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == timer) {
+            *prev = timer->next;
+            break;
+        }
+    }
+    free(timer);
+}
+
+CARD32
+GetTimeInMillis(void)
+{
+    return (CARD32)(stub_now() / 1000000);
+}
+
+Bool
+QueueWorkProc(Bool (*function)(ClientPtr client, pointer closure),
+              ClientPtr client, pointer closure)
+{
+    StubWorkPtr work;
+
+    if (!(work = calloc(1, sizeof(StubWorkRec))))
+        return FALSE;
+    work->function = function;
+    work->client = client;
+    work->closure = closure;
+    _work_append(work);
+    return TRUE;
+}
+
+static void
+_work_append(StubWorkPtr work)
+{
+    StubWorkPtr *prev;
+
+    for (prev = &stub_work; *prev != NULL; prev = &(*prev)->next)
+        ;
+    work->next = NULL;
+    *prev = work;
+}
+
+/* Devices */
+
+Bool
+EnableDevice(DeviceIntPtr device, BOOL sendevent)
+{
+    if (device->enabled)
+        return TRUE;
+    if (device->deviceProc(device, DEVICE_ON) != Success)
+        return FALSE;
+    device->enabled = TRUE;
+    return TRUE;
+}
+
+Bool
+DisableDevice(DeviceIntPtr device, BOOL sendevent)
+{
+    if (!device->enabled)
+        return TRUE;
+    device->deviceProc(device, DEVICE_OFF);
+    device->enabled = FALSE;
+    return TRUE;
+}
+
+Bool
+InitButtonClassDeviceStruct(DeviceIntPtr device, int numButtons,
+                            Atom *labels, CARD8 *map)
+{
+    return TRUE;
+}
+
+Bool
+InitValuatorClassDeviceStruct(DeviceIntPtr device, int numAxes, Atom *labels,
+                              int numMotionEvents, int mode)
+{
+    if (!(device->valuator = calloc(1, sizeof(ValuatorClassRec))))
+        return FALSE;
+    device->valuator->numAxes = numAxes;
+    device->valuator->mode = mode;
+    return TRUE;
+}
+
+Bool
+InitAbsoluteClassDeviceStruct(DeviceIntPtr device)
+{
+    return TRUE;
+}
+
+int
+GetMotionHistorySize(void)
+{
+    return 0;
+}
+
+void
+xf86InitValuatorAxisStruct(DeviceIntPtr dev, int axnum, Atom label,
+                           int minval, int maxval, int resolution,
+                           int min_res, int max_res)
+{
+}
+
+void
+xf86InitValuatorDefaults(DeviceIntPtr dev, int i)
+{
+}
+
+/* Properties */
+
+/**
+ * Interns an atom.  The atoms of Xatom.h are predefined, so interned
+ * atoms start after them.
+ */
+Atom
+MakeAtom(const char *string, unsigned len, Bool makeit)
+{
+    char **atoms;
+    int i;
+
+    for (i = 0; i < stub_num_atoms; i++) {
+        if (strlen(stub_atoms[i]) == len &&
+            strncmp(stub_atoms[i], string, len) == 0)
+            return XA_LAST_PREDEFINED + 1 + i;
+    }
+    if (!makeit)
+        return None;
+
+    atoms = realloc(stub_atoms, (stub_num_atoms + 1) * sizeof(char *));
+    if (atoms == NULL)
+        return None;
+    stub_atoms = atoms;
+    if (!(stub_atoms[stub_num_atoms] = strndup(string, len)))
+        return None;
+    return XA_LAST_PREDEFINED + 1 + stub_num_atoms++;
+}
+
+Atom
+XIGetKnownProperty(char *name)
+{
+    return MakeAtom(name, strlen(name), TRUE);
+}
+
+/**
+ * Replaces the value of a property.  Like the server, the property
+ * handler is run twice: it may refuse the value in the checkonly pass,
+ * what it returns in the second pass is ignored.
+ */
+int
+XIChangeDeviceProperty(DeviceIntPtr dev, Atom property, Atom type,
+                       int format, int mode, unsigned long len,
+                       pointer value, Bool sendevent)
+{
+    StubPropertyPtr prop;
+    XIPropertyValueRec new_value;
+    int rc;
+
+    new_value.type = type;
+    new_value.format = format;
+    new_value.size = len;
+    if (!(new_value.data = malloc(len * (format / 8) + 1)))
+        return BadAlloc;
+    memcpy(new_value.data, value, len * (format / 8));
+
+    if (dev->set_property) {
+        rc = dev->set_property(dev, property, &new_value, TRUE);
+        if (rc != Success) {
+            free(new_value.data);
+            return rc;
+        }
+        dev->set_property(dev, property, &new_value, FALSE);
+    }
+
+    if (!(prop = _property_find(dev, property))) {
+        if (!(prop = calloc(1, sizeof(StubPropertyRec)))) {
+            free(new_value.data);
+            return BadAlloc;
+        }
+        prop->name = property;
+        prop->next = dev->properties;
+        dev->properties = prop;
+    }
+    free(prop->value.data);
+    prop->value = new_value;
+    return Success;
+}
+
+int
+XISetDevicePropertyDeletable(DeviceIntPtr dev, Atom property, Bool deletable)
+{
+    return Success;
+}
+
+long
+XIRegisterPropertyHandler(DeviceIntPtr dev, XISetPropertyProc SetProperty,
+                          XIGetPropertyProc GetProperty,
+                          XIDeletePropertyProc DeleteProperty)
+{
+    dev->set_property = SetProperty;
+    dev->get_property = GetProperty;
+    return 1;
+}
+
+static StubPropertyPtr
+_property_find(DeviceIntPtr dev, Atom name)
+{
+    StubPropertyPtr prop;
+
+    for (prop = dev->properties; prop != NULL; prop = prop->next)
+        if (prop->name == name)
+            return prop;
+    return NULL;
+}
+
+/* Input drivers */
+
+void
+xf86AddInputDriver(InputDriverPtr driver, pointer module, int flags)
+{
+    stub_driver = driver;
+}
+
+InputInfoPtr
+xf86AllocateInput(InputDriverPtr drv, int flags)
+{
+    InputInfoPtr pInfo;
+
+    if (!(pInfo = calloc(1, sizeof(InputInfoRec))))
+        return NULL;
+    pInfo->drv = drv;
+    pInfo->fd = -1;
+    pInfo->next = xf86InputDevs;
+    xf86InputDevs = pInfo;
+    return pInfo;
+}
+
+void
+xf86DeleteInput(InputInfoPtr pInp, int flags)
+{
+    InputInfoPtr *prev;
+
+    for (prev = &xf86InputDevs; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == pInp) {
+            *prev = pInp->next;
+            break;
+        }
+    }
+    free(pInp->private);
+    free(pInp->name);
+    free(pInp);
+}
+
+void
+xf86CollectInputOptions(InputInfoPtr pInfo, const char **defaultOpts,
+                        pointer extraOpts)
+{
+    pInfo->options = pInfo->conf_idev->commonOptions;
+}
+
+void
+xf86ProcessCommonOptions(InputInfoPtr pInfo, pointer options)
+{
+}
+
+/* Options */
+
+static const char *
+_option_find(pointer optlist, const char *name)
+{
+    const char **opt;
+
+    for (opt = optlist; opt != NULL && opt[0] != NULL; opt += 2)
+        if (xf86NameCmp(opt[0], name) == 0)
+            return opt[1];
+    return NULL;
+}
+
+char *
+xf86CheckStrOption(pointer optlist, const char *name, char *deflt)
+{
+    const char *value = _option_find(optlist, name);
+
+    return xstrdup(value ? value : deflt);
+}
+
+char *
+xf86SetStrOption(pointer optlist, const char *name, char *deflt)
+{
+    return xf86CheckStrOption(optlist, name, deflt);
+}
+
+int
+xf86CheckIntOption(pointer optlist, const char *name, int deflt)
+{
+    const char *value = _option_find(optlist, name);
+
+    return value ? (int)strtol(value, NULL, 0) : deflt;
+}
+
+int
+xf86SetIntOption(pointer optlist, const char *name, int deflt)
+{
+    return xf86CheckIntOption(optlist, name, deflt);
+}
+
+Bool
+xf86CheckBoolOption(pointer optlist, const char *name, int deflt)
+{
+    const char *value = _option_find(optlist, name);
+
+    if (value == NULL)
+        return deflt;
+    if (xf86NameCmp(value, "1") == 0 || xf86NameCmp(value, "on") == 0 ||
+        xf86NameCmp(value, "true") == 0 || xf86NameCmp(value, "yes") == 0)
+        return TRUE;
+    if (xf86NameCmp(value, "0") == 0 || xf86NameCmp(value, "off") == 0 ||
+        xf86NameCmp(value, "false") == 0 || xf86NameCmp(value, "no") == 0)
+        return FALSE;
+    return deflt;
+}
+
+double
+xf86SetRealOption(pointer optlist, const char *name, double deflt)
+{
+    const char *value = _option_find(optlist, name);
+
+    return value ? strtod(value, NULL) : deflt;
+}
+
+/**
+ * Compares option names like the server: case, '_' and ' ' are ignored
+ */
+int
+xf86NameCmp(const char *s1, const char *s2)
+{
+    int c1, c2;
+
+    for (;;) {
+        while (*s1 == '_' || *s1 == ' ')
+            s1++;
+        while (*s2 == '_' || *s2 == ' ')
+            s2++;
+        c1 = tolower((unsigned char)*s1++);
+        c2 = tolower((unsigned char)*s2++);
+        if (c1 != c2 || c1 == '\0')
+            return c1 - c2;
+    }
+}
+
+/* Input and events */
+
+/**
+ * Waits up to timeout us for fd to become readable
+ */
+int
+xf86WaitForInput(int fd, int timeout)
+{
+    fd_set readfds;
+    struct timeval to;
+    int res;
+
+    do {
+        FD_ZERO(&readfds);
+        FD_SET(fd, &readfds);
+        to.tv_sec = timeout / 1000000;
+        to.tv_usec = timeout % 1000000;
+        res = select(fd + 1, &readfds, NULL, NULL, &to);
+    } while (res == -1 && errno == EINTR);
+    return res;
+}
+
+void
+xf86FlushInput(int fd)
+{
+    char buf[4096];
+
+    while (xf86WaitForInput(fd, 0) > 0)
+        if (read(fd, buf, sizeof(buf)) < 1)
+            break;
+}
+
+void
+xf86AddEnabledDevice(InputInfoPtr pInfo)
+{
+}
+
+void
+xf86RemoveEnabledDevice(InputInfoPtr pInfo)
+{
+}
+
+void
+AddEnabledDevice(int fd)
+{
+}
+
+void
+RemoveEnabledDevice(int fd)
+{
+}
+
+int
+xf86BlockSIGIO(void)
+{
+    return 0;
+}
+
+void
+xf86UnblockSIGIO(int wasset)
+{
+}
+
+void
+xf86PostMotionEventP(DeviceIntPtr device, int is_absolute,
+                     int first_valuator, int num_valuators, int *valuators)
+{
+    StubEventPtr ev = _event_new(device, STUB_MOTION);
+    int i;
+
+    if (ev == NULL)
+        return;
+    ev->first_valuator = first_valuator;
+    ev->num_valuators = min(num_valuators, STUB_MAX_VALUATORS);
+    for (i = 0; i < ev->num_valuators; i++)
+        ev->valuators[i] = valuators[i];
+}
+
+void
+xf86PostButtonEvent(DeviceIntPtr device, int is_absolute, int button,
+                    int is_down, int first_valuator, int num_valuators, ...)
+{
+    StubEventPtr ev = _event_new(device, STUB_BUTTON);
+    va_list args;
+    int i;
+
+    if (ev == NULL)
+        return;
+    ev->button = button;
+    ev->is_down = is_down;
+    ev->first_valuator = first_valuator;
+    ev->num_valuators = min(num_valuators, STUB_MAX_VALUATORS);
+    va_start(args, num_valuators);
+    for (i = 0; i < ev->num_valuators; i++)
+        ev->valuators[i] = va_arg(args, int);
+    va_end(args);
+}
+
+/**
+ * Logs an event.  Events past STUB_MAX_EVENTS are only counted.
+ */
+static StubEventPtr
+_event_new(DeviceIntPtr dev, int type)
+{
+    StubEventPtr ev;
+
+    if (stub_num_events++ >= STUB_MAX_EVENTS)
+        return NULL;
+
+    ev = &stub_events[stub_num_events - 1];
+    memset(ev, 0, sizeof(StubEventRec));
+    ev->type = type;
+    ev->dev = dev;
+    ev->time = stub_now();
+    return ev;
+}
+
+/**
+ * Keeps the driver from creating its subdevices through HAL; the test
+ * programs create them with stub_device_new()
+ */
+DBusConnection *
+dbus_bus_get(DBusBusType type, DBusError *error)
+{
+    dbus_set_error_const(error, DBUS_ERROR_NO_SERVER,
+                         "The stub server has no bus");
+    return NULL;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2009 Ryan Huffman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Authors:
+ *	Ryan Huffman (ryanhuffman@gmail.com)
+ */
+
+/*
+ * A stub X server for the test programs.  The driver (src/tuio.c) is
+ * built against the headers in stubs/, which declare the parts of the
+ * server API it uses; tuio-stubs.c implements them well enough to load
+ * the driver, create devices, run its timers and property handlers and
+ * log the events it posts.
+ */
+
+#ifndef _TUIO_STUBS_H_
+#define _TUIO_STUBS_H_
+
+#include <stdint.h>
+#include <xf86Xinput.h>
+
+#define STUB_MAX_EVENTS 4096 /* Events kept in the event log */
+#define STUB_MAX_VALUATORS 6
+#define STUB_MAX_TOUCHES 512 /* Touches in a frame written by stub_frame() */
+
+/* Event types in the event log */
+#define STUB_MOTION 0
+#define STUB_BUTTON 1
+
+typedef struct _StubEvent {
+    int type;
+    DeviceIntPtr dev;
+    int button; /* Button events only */
+    int is_down;
+    int first_valuator;
+    int num_valuators;
+    int valuators[STUB_MAX_VALUATORS];
+    int64_t time; /* ns, see stub_now() */
+} StubEventRec, *StubEventPtr;
+
+/* Messages stub_frame() writes besides the set messages */
+#define STUB_ALIVE 1
+#define STUB_FSEQ 2
+
+/* A touch of a frame written by stub_frame() */
+typedef struct _StubTouch {
+    int id;
+    float x, y; /* 0 - 1 */
+} StubTouchRec, *StubTouchPtr;
+
+/* Events posted since the last stub_events_clear(), the first
+ * STUB_MAX_EVENTS of them are in stub_events */
+extern StubEventRec stub_events[STUB_MAX_EVENTS];
+extern int stub_num_events;
+
+/* xalloc(), xcalloc(), xrealloc() and xstrdup() calls so far */
+extern unsigned long stub_allocs;
+
+/* Print what the driver logs */
+extern int stub_verbose;
+
+extern int64_t stub_now(void);
+extern void stub_events_clear(void);
+extern Bool stub_load_driver(void);
+extern DeviceIntPtr stub_device_new(const char *name, const char **options);
+extern void stub_device_free(DeviceIntPtr dev);
+extern void stub_run(void);
+extern void stub_wait(InputInfoPtr pInfo, int64_t until);
+extern pointer stub_get_property(DeviceIntPtr dev, const char *name,
+                                 long *size);
+extern int stub_set_property(DeviceIntPtr dev, const char *name, Atom type,
+                             int format, long size, pointer data);
+extern int stub_frame(char *buf, const StubTouchRec *touches, int num_touches,
+                      int first, int num_set, int flags, int32_t fseq);
+
+#endif